@@ -2,6 +2,7 @@
 
 #include "engine/asset_manager.h"
 #include "engine/engine.h"
+#include "engine/ecs_cmd_buffer.h"
 #include "engine/entity_manager.h"
 #include "engine/filesystem.h"
 #include "engine/scene.h"
@@ -17,10 +18,14 @@
 #include "engine/camera.h"
 #include "engine/environment.h"
 
+#include "engine/parallel_for.h"
+#include "engine/system_registry.h"
+#include "engine/task_graph.h"
 #include "engine/task_scheduler.h"
 
 #include "engine/comps/comp_types.h"
 #include "engine/comps/gltf_comp.h"
+#include "engine/comps/hierarchy_comp.h"
 #include "engine/comps/mesh_comp.h"
 #include "engine/comps/point_light_comp.h"
 #include "engine/comps/renderable_comp.h"
@@ -30,6 +35,7 @@
 #include "engine/systems/fps_camera_system.h"
 #include "engine/systems/light_system.h"
 #include "engine/systems/rendering_system.h"
+#include "engine/systems/transform_system.h"
 
 #include "engine/assets/asset_types.h"
 #include "engine/assets/gltf_asset.h"
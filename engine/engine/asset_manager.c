@@ -1,150 +1,892 @@
 #include "asset_manager.h"
 
+#include "util.h"
 #include <assert.h>
+#include <renderer/context.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define MAX(a, b) ((a > b) ? a : b)
 
+#define INITIAL_UID_CAP 256
+#define INITIAL_SOURCE_CAP 64
+
+// Each pool allocates blocks of about this size
+#define POOL_BLOCK_SIZE 16384
+#define ASSET_ALIGNMENT 16
+
+// Removed entries become tombstones instead of leaving a hole, so the entries
+// after them never move while readers probe the table
+#define EMPTY_ENTRY UINT64_MAX
+#define TOMBSTONE_ENTRY ((uint64_t)EG_NULL_ASSET_UID)
+
+static inline uint64_t uid_entry(eg_asset_uid_t uid, uint32_t index) {
+  return ((uint64_t)index << 32) | uid;
+}
+
+static inline eg_asset_uid_t entry_uid(uint64_t entry) {
+  return (eg_asset_uid_t)entry;
+}
+
+static inline uint32_t entry_index(uint64_t entry) {
+  return (uint32_t)(entry >> 32);
+}
+
+// Murmur3's finalizer, so that sequential UIDs spread over the whole table
+static inline uint32_t hash_uid(eg_asset_uid_t uid) {
+  uid ^= uid >> 16;
+  uid *= 0x85ebca6b;
+  uid ^= uid >> 13;
+  uid *= 0xc2b2ae35;
+  uid ^= uid >> 16;
+  return uid;
+}
+
+// Returns the position of the UID's entry and stores the entry in `entry`, or
+// returns UINT32_MAX if it's not there. Readers can call it while a writer
+// changes the table: entries are only ever replaced in place, and at most
+// half of them are in use or tombstones, so the probe always reaches an
+// empty one.
+static uint32_t
+uid_find(eg_asset_uid_table_t *table, eg_asset_uid_t uid, uint64_t *entry) {
+  const uint32_t mask = table->cap - 1;
+
+  for (uint32_t i = hash_uid(uid) & mask;; i = (i + 1) & mask) {
+    *entry = atomic_load_explicit(&table->entries[i], memory_order_acquire);
+    if (*entry == EMPTY_ENTRY) return UINT32_MAX;
+    if (entry_uid(*entry) == uid) return i;
+  }
+}
+
+// Puts the entry in the first empty entry or tombstone of its probe sequence.
+// Returns whether it replaced a tombstone.
+static bool uid_put(eg_asset_uid_table_t *table, uint64_t entry) {
+  const uint32_t mask = table->cap - 1;
+
+  for (uint32_t i = hash_uid(entry_uid(entry)) & mask;; i = (i + 1) & mask) {
+    uint64_t current =
+        atomic_load_explicit(&table->entries[i], memory_order_relaxed);
+    if (current == EMPTY_ENTRY || current == TOMBSTONE_ENTRY) {
+      atomic_store_explicit(&table->entries[i], entry, memory_order_release);
+      return current == TOMBSTONE_ENTRY;
+    }
+  }
+}
+
+static eg_asset_uid_table_t *alloc_uid_table(uint32_t cap) {
+  eg_asset_uid_table_t *table =
+      malloc(sizeof(*table) + cap * sizeof(table->entries[0]));
+  table->cap           = cap;
+  table->retired       = NULL;
+  table->retired_frame = 0;
+  for (uint32_t i = 0; i < cap; i++) {
+    atomic_init(&table->entries[i], EMPTY_ENTRY);
+  }
+  return table;
+}
+
+// The functions below change the UID table, with the mutex locked
+
+static void uid_insert(
+    eg_asset_manager_t *asset_manager, eg_asset_uid_t uid, uint32_t index) {
+  eg_asset_uid_table_t *table =
+      atomic_load_explicit(&asset_manager->uid_table, memory_order_relaxed);
+
+  assert(uid != EG_NULL_ASSET_UID);
+#ifndef NDEBUG
+  uint64_t existing;
+  assert(
+      uid_find(table, uid, &existing) == UINT32_MAX && "duplicate asset UID");
+#endif
+
+  uint32_t used = asset_manager->uid_count + asset_manager->uid_tombstones;
+  if ((used + 1) * 2 > table->cap) {
+    // Rebuild the table without the tombstones, growing it if the assets
+    // alone would fill more than a quarter of it
+    uint32_t new_cap = table->cap;
+    if ((asset_manager->uid_count + 1) * 4 > table->cap) new_cap *= 2;
+
+    eg_asset_uid_table_t *new_table = alloc_uid_table(new_cap);
+
+    for (uint32_t i = 0; i < table->cap; i++) {
+      uint64_t entry =
+          atomic_load_explicit(&table->entries[i], memory_order_relaxed);
+      if (entry != EMPTY_ENTRY && entry != TOMBSTONE_ENTRY) {
+        uid_put(new_table, entry);
+      }
+    }
+
+    // Readers might still be probing the old table, see
+    // eg_asset_manager_next_frame
+    table->retired_frame = asset_manager->frame;
+    new_table->retired   = table;
+    atomic_store_explicit(
+        &asset_manager->uid_table, new_table, memory_order_release);
+    table = new_table;
+
+    asset_manager->uid_tombstones = 0;
+  }
+
+  if (uid_put(table, uid_entry(uid, index))) {
+    asset_manager->uid_tombstones--;
+  }
+  asset_manager->uid_count++;
+}
+
+static void uid_remove(eg_asset_manager_t *asset_manager, eg_asset_uid_t uid) {
+  eg_asset_uid_table_t *table =
+      atomic_load_explicit(&asset_manager->uid_table, memory_order_relaxed);
+
+  uint64_t entry;
+  uint32_t i = uid_find(table, uid, &entry);
+  if (i == UINT32_MAX) return;
+
+  atomic_store_explicit(
+      &table->entries[i], TOMBSTONE_ENTRY, memory_order_release);
+  asset_manager->uid_count--;
+  asset_manager->uid_tombstones++;
+}
+
+// Frees the tables that were replaced before the previous frame. Called with
+// the mutex locked.
+static void free_retired_tables(eg_asset_manager_t *asset_manager) {
+  eg_asset_uid_table_t *table =
+      atomic_load_explicit(&asset_manager->uid_table, memory_order_relaxed);
+
+  // Newest first, so everything after the first old enough table goes
+  while (table->retired != NULL &&
+         asset_manager->frame - table->retired->retired_frame < 2) {
+    table = table->retired;
+  }
+
+  eg_asset_uid_table_t *retired = table->retired;
+  table->retired                = NULL;
+
+  while (retired != NULL) {
+    eg_asset_uid_table_t *next = retired->retired;
+    free(retired);
+    retired = next;
+  }
+}
+
+// The source table is only used with the mutex locked, so unlike the UID
+// table it doesn't need atomics, and removals can shift entries back
+
+// Returns the position of the source's entry, or UINT32_MAX if it's not there
+static uint32_t source_find(
+    eg_asset_manager_t *asset_manager,
+    re_hash_t hash,
+    eg_asset_type_t asset_type,
+    const char *path) {
+  if (asset_manager->source_cap == 0) return UINT32_MAX;
+
+  const uint32_t mask = asset_manager->source_cap - 1;
+
+  for (uint32_t i = (uint32_t)hash & mask;; i = (i + 1) & mask) {
+    eg_asset_source_t *source = &asset_manager->sources[i];
+    if (source->hash == 0) return UINT32_MAX;
+    if (source->hash == hash && source->asset->type == asset_type &&
+        strcmp(source->path, path) == 0) {
+      return i;
+    }
+  }
+}
+
+static void source_put(
+    eg_asset_source_t *sources, uint32_t cap, eg_asset_source_t source) {
+  const uint32_t mask = cap - 1;
+
+  for (uint32_t i = (uint32_t)source.hash & mask;; i = (i + 1) & mask) {
+    if (sources[i].hash == 0) {
+      sources[i] = source;
+      return;
+    }
+  }
+}
+
+static void source_insert(
+    eg_asset_manager_t *asset_manager,
+    re_hash_t hash,
+    const char *path,
+    eg_asset_t *asset) {
+  if ((asset_manager->source_count + 1) * 2 > asset_manager->source_cap) {
+    uint32_t new_cap = MAX(asset_manager->source_cap * 2, INITIAL_SOURCE_CAP);
+
+    eg_asset_source_t *new_sources = calloc(new_cap, sizeof(*new_sources));
+
+    for (uint32_t i = 0; i < asset_manager->source_cap; i++) {
+      if (asset_manager->sources[i].hash != 0) {
+        source_put(new_sources, new_cap, asset_manager->sources[i]);
+      }
+    }
+
+    free(asset_manager->sources);
+    asset_manager->sources    = new_sources;
+    asset_manager->source_cap = new_cap;
+  }
+
+  source_put(
+      asset_manager->sources,
+      asset_manager->source_cap,
+      (eg_asset_source_t){hash, strdup(path), asset});
+  asset_manager->source_count++;
+
+  asset->source_hash = hash;
+}
+
+// Backward shift deletion: the entries after the removed one are moved back
+// into the hole when that's still on their probe sequence, so lookups never
+// need tombstones
+static void
+source_remove(eg_asset_manager_t *asset_manager, eg_asset_t *asset) {
+  if (asset->source_hash == 0) return;
+
+  const uint32_t mask = asset_manager->source_cap - 1;
+
+  uint32_t hole = (uint32_t)asset->source_hash & mask;
+  while (asset_manager->sources[hole].asset != asset) {
+    hole = (hole + 1) & mask;
+  }
+
+  free(asset_manager->sources[hole].path);
+
+  for (uint32_t i = (hole + 1) & mask;; i = (i + 1) & mask) {
+    eg_asset_source_t *source = &asset_manager->sources[i];
+    if (source->hash == 0) break;
+
+    uint32_t home = (uint32_t)source->hash & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      asset_manager->sources[hole] = *source;
+      hole                         = i;
+    }
+  }
+
+  asset_manager->sources[hole] = (eg_asset_source_t){0};
+  asset_manager->source_count--;
+
+  asset->source_hash = 0;
+}
+
+static _Atomic(eg_asset_t *) *
+get_slot(eg_asset_manager_t *asset_manager, uint32_t index) {
+  // Slot i is at position i + EG_ASSET_FIRST_SEGMENT_SIZE counting from the
+  // start of a (virtual) segment before the first one, which makes the
+  // segment sizes line up with powers of two
+  uint32_t position = index + EG_ASSET_FIRST_SEGMENT_SIZE;
+  uint32_t segment  = eg_log2_32(position) - EG_ASSET_FIRST_SEGMENT_SHIFT;
+
+  _Atomic(eg_asset_t *) *slots = atomic_load_explicit(
+      &asset_manager->segments[segment], memory_order_acquire);
+  if (slots == NULL) return NULL;
+
+  return &slots[position - (EG_ASSET_FIRST_SEGMENT_SIZE << segment)];
+}
+
+// Called with the mutex locked
+static uint32_t take_slot(eg_asset_manager_t *asset_manager) {
+  if (asset_manager->free_slot_count > 0) {
+    // Reuse the last freed slot
+    return asset_manager->free_slots[--asset_manager->free_slot_count];
+  }
+
+  uint32_t index =
+      atomic_load_explicit(&asset_manager->count, memory_order_relaxed);
+
+  // If every slot has been used, add a segment
+  if (index >= asset_manager->cap) {
+    uint32_t segment = asset_manager->segment_count++;
+    assert(segment < EG_ASSET_MAX_SEGMENTS);
+
+    uint32_t size                = EG_ASSET_FIRST_SEGMENT_SIZE << segment;
+    _Atomic(eg_asset_t *) *slots = malloc(size * sizeof(*slots));
+    for (uint32_t i = 0; i < size; i++) {
+      atomic_init(&slots[i], NULL);
+    }
+
+    atomic_store_explicit(
+        &asset_manager->segments[segment], slots, memory_order_release);
+
+    asset_manager->cap += size;
+    asset_manager->free_slots = realloc(
+        asset_manager->free_slots,
+        asset_manager->cap * sizeof(*asset_manager->free_slots));
+  }
+
+  atomic_store_explicit(&asset_manager->count, index + 1, memory_order_release);
+  return index;
+}
+
+static void pool_init(eg_asset_pool_t *pool, size_t size) {
+  mtx_init(&pool->mutex, mtx_plain);
+
+  pool->stride = (size + ASSET_ALIGNMENT - 1) & ~(size_t)(ASSET_ALIGNMENT - 1);
+
+  pool->assets_per_block = (uint32_t)MAX(POOL_BLOCK_SIZE / pool->stride, 1);
+  pool->blocks           = NULL;
+  pool->block_count      = 0;
+  pool->free             = NULL;
+}
+
+// Called with the pool's mutex locked
+static void *pool_alloc(eg_asset_pool_t *pool) {
+  if (pool->free == NULL) {
+    char *block = malloc(pool->assets_per_block * pool->stride);
+
+    pool->blocks = realloc(
+        pool->blocks, (pool->block_count + 1) * sizeof(*pool->blocks));
+    pool->blocks[pool->block_count++] = block;
+
+    // Linked back to front, so the block is handed out in address order
+    for (uint32_t i = pool->assets_per_block; i-- > 0;) {
+      void **asset = (void **)(block + i * pool->stride);
+      *asset       = pool->free;
+      pool->free   = asset;
+    }
+  }
+
+  void **asset = pool->free;
+  pool->free   = *asset;
+  return asset;
+}
+
+// Called with the pool's mutex locked
+static void pool_free(eg_asset_pool_t *pool, void *asset) {
+  *(void **)asset = pool->free;
+  pool->free      = asset;
+}
+
+static void pool_destroy(eg_asset_pool_t *pool) {
+  for (uint32_t i = 0; i < pool->block_count; i++) {
+    free(pool->blocks[i]);
+  }
+  free(pool->blocks);
+
+  mtx_destroy(&pool->mutex);
+}
+
 void eg_asset_manager_init(eg_asset_manager_t *asset_manager) {
   mtx_init(&asset_manager->mutex, mtx_plain);
 
-  // Allocator with 16k blocks
-  fstd_allocator_init(&asset_manager->allocator, 16384);
+  for (uint32_t i = 0; i < EG_ASSET_TYPE_MAX; i++) {
+    pool_init(&asset_manager->pools[i], EG_ASSET_SIZES[i]);
+  }
+
+  for (uint32_t i = 0; i < EG_ASSET_MAX_SEGMENTS; i++) {
+    atomic_init(&asset_manager->segments[i], NULL);
+  }
+  asset_manager->segment_count = 0;
+
+  asset_manager->cap = 0;
+  atomic_init(&asset_manager->count, 0);
+
+  asset_manager->free_slots      = NULL;
+  asset_manager->free_slot_count = 0;
+
+  atomic_init(&asset_manager->next_uid, 0);
 
-  asset_manager->cap      = 128;
-  asset_manager->count    = 0;
-  asset_manager->next_uid = 0;
-  asset_manager->assets   = realloc(
-      asset_manager->assets,
-      asset_manager->cap * sizeof(*asset_manager->assets));
-  memset(
-      asset_manager->assets,
-      0,
-      asset_manager->cap * sizeof(*asset_manager->assets));
+  atomic_init(&asset_manager->uid_table, alloc_uid_table(INITIAL_UID_CAP));
+  asset_manager->uid_count      = 0;
+  asset_manager->uid_tombstones = 0;
+
+  atomic_init(&asset_manager->pending_loads, 0);
+
+  asset_manager->sources      = NULL;
+  asset_manager->source_cap   = 0;
+  asset_manager->source_count = 0;
+  atomic_init(&asset_manager->load_hits, 0);
+  atomic_init(&asset_manager->load_misses, 0);
+
+  asset_manager->load_callbacks      = NULL;
+  asset_manager->load_callback_cap   = 0;
+  asset_manager->load_callback_count = 0;
+
+  asset_manager->deletions      = NULL;
+  asset_manager->deletion_cap   = 0;
+  asset_manager->deletion_count = 0;
+  asset_manager->frame          = 0;
+  asset_manager->destroying     = false;
 }
 
-void *eg_asset_manager_alloc(
-    eg_asset_manager_t *asset_manager, eg_asset_type_t asset_type) {
-  void *asset = eg_asset_manager_alloc_uid(
-      asset_manager, asset_type, asset_manager->next_uid);
+static eg_asset_t *new_asset(
+    eg_asset_manager_t *asset_manager,
+    eg_asset_type_t asset_type,
+    eg_asset_uid_t uid,
+    eg_asset_state_t state) {
+  // Keep next_uid past every UID in use
+  eg_asset_uid_t next_uid = atomic_load(&asset_manager->next_uid);
+  while (next_uid <= uid) {
+    if (atomic_compare_exchange_weak(
+            &asset_manager->next_uid, &next_uid, uid + 1)) {
+      break;
+    }
+  }
+
+  eg_asset_pool_t *pool = &asset_manager->pools[asset_type];
+
+  mtx_lock(&pool->mutex);
+  eg_asset_t *asset = pool_alloc(pool);
+  mtx_unlock(&pool->mutex);
+
+  memset(asset, 0, sizeof(*asset));
+
+  asset->type    = asset_type;
+  asset->uid     = uid;
+  asset->manager = asset_manager;
+  atomic_init(&asset->state, state);
+  atomic_init(&asset->ref_count, 1);
 
   return asset;
 }
 
-void *eg_asset_manager_alloc_uid(
+// Puts the asset in a slot and in the UID table. Called with the mutex locked,
+// once the asset is initialized, since lookups don't lock.
+static void link_asset(eg_asset_manager_t *asset_manager, eg_asset_t *asset) {
+  asset->index = take_slot(asset_manager);
+
+  atomic_store_explicit(
+      get_slot(asset_manager, asset->index), asset, memory_order_release);
+  uid_insert(asset_manager, asset->uid, asset->index);
+}
+
+static eg_asset_t *alloc_asset(
     eg_asset_manager_t *asset_manager,
     eg_asset_type_t asset_type,
-    eg_asset_uid_t uid) {
+    eg_asset_uid_t uid,
+    eg_asset_state_t state) {
+  eg_asset_t *asset = new_asset(asset_manager, asset_type, uid, state);
+
   mtx_lock(&asset_manager->mutex);
+  link_asset(asset_manager, asset);
+  mtx_unlock(&asset_manager->mutex);
 
-  asset_manager->next_uid = MAX(uid + 1, asset_manager->next_uid);
+  return asset;
+}
 
-  eg_asset_t *asset = fstd_alloc(
-      &asset_manager->allocator, (uint32_t)EG_ASSET_SIZES[asset_type]);
-  memset(asset, 0, sizeof(*asset));
+void *eg_asset_manager_alloc(
+    eg_asset_manager_t *asset_manager, eg_asset_type_t asset_type) {
+  return alloc_asset(
+      asset_manager,
+      asset_type,
+      atomic_fetch_add(&asset_manager->next_uid, 1),
+      EG_ASSET_STATE_READY);
+}
 
-  uint32_t index = UINT32_MAX;
+void *eg_asset_manager_alloc_uid(
+    eg_asset_manager_t *asset_manager,
+    eg_asset_type_t asset_type,
+    eg_asset_uid_t uid) {
+  return alloc_asset(asset_manager, asset_type, uid, EG_ASSET_STATE_READY);
+}
 
-  // Look for the first empty asset slot
-  for (uint32_t i = 0; i < asset_manager->cap; i++) {
-    if (asset_manager->assets[i] == NULL) {
-      index = i;
-      break;
+typedef struct asset_load_t {
+  eg_asset_manager_t *asset_manager;
+  eg_task_scheduler_t *scheduler;
+  eg_asset_t *asset;
+  void *decoded;
+  thrd_start_t routine;
+  void *args;
+} asset_load_t;
+
+// Runs the callbacks of the loads that returned the asset while it was still
+// loading. The mutex isn't held while they run, so they can load assets too.
+static void
+run_load_callbacks(eg_asset_manager_t *asset_manager, eg_asset_t *asset) {
+  eg_asset_load_callback_t *callbacks = asset_manager->load_callbacks;
+
+  for (;;) {
+    mtx_lock(&asset_manager->mutex);
+
+    uint32_t i = 0;
+    while (i < asset_manager->load_callback_count &&
+           callbacks[i].asset != asset) {
+      i++;
+    }
+
+    if (i == asset_manager->load_callback_count) {
+      mtx_unlock(&asset_manager->mutex);
+      return;
     }
+
+    eg_asset_load_callback_t callback = callbacks[i];
+    asset_manager->load_callback_count--;
+    memmove(
+        &callbacks[i],
+        &callbacks[i + 1],
+        (asset_manager->load_callback_count - i) * sizeof(*callbacks));
+
+    mtx_unlock(&asset_manager->mutex);
+
+    callback.routine(callback.args);
+
+    // The array might have grown in the meantime
+    callbacks = asset_manager->load_callbacks;
   }
+}
+
+static int upload_task(void *args) {
+  asset_load_t *load = args;
+  eg_asset_t *asset  = load->asset;
+
+  eg_asset_state_t state = EG_ASSET_STATE_FAILED;
+  if (load->decoded != NULL) {
+    EG_ASSET_LOADERS[asset->type].upload(asset, load->decoded);
+    state = EG_ASSET_STATE_READY;
+  } else {
+    // So that loading it again tries again
+    mtx_lock(&load->asset_manager->mutex);
+    source_remove(load->asset_manager, asset);
+    mtx_unlock(&load->asset_manager->mutex);
+  }
+
+  atomic_store_explicit(&asset->state, state, memory_order_release);
+  atomic_fetch_sub(&load->asset_manager->pending_loads, 1);
 
-  // If no available slot was found
-  if (index == UINT32_MAX) {
-    // Double the amount of slots
-    asset_manager->cap *= 2;
-    asset_manager->assets = realloc(
-        asset_manager->assets,
-        asset_manager->cap * sizeof(*asset_manager->assets));
+  if (load->routine != NULL) load->routine(load->args);
+  run_load_callbacks(load->asset_manager, asset);
 
-    // Set the new ones to NULL
-    memset(
-        &asset_manager->assets[asset_manager->cap / 2],
-        0,
-        (asset_manager->cap / 2) * sizeof(*asset_manager->assets));
+  eg_asset_release(asset);
 
-    // Set the index to the first newly created slot
-    index = asset_manager->cap / 2;
+  free(load);
+  return 0;
+}
+
+// Called with the mutex locked, on a load that returned an asset from the
+// source table
+static void add_load_callback(
+    eg_asset_manager_t *asset_manager,
+    eg_task_scheduler_t *scheduler,
+    eg_asset_t *asset,
+    thrd_start_t routine,
+    void *args) {
+  // The load in flight sets the state before it takes the mutex to run the
+  // callbacks, so a pending asset hasn't run them yet
+  if (atomic_load_explicit(&asset->state, memory_order_acquire) !=
+      EG_ASSET_STATE_PENDING) {
+    eg_scheduler_add_main_task(scheduler, routine, args);
+    return;
   }
 
-  asset_manager->assets[index] = asset;
+  if (asset_manager->load_callback_count >= asset_manager->load_callback_cap) {
+    asset_manager->load_callback_cap =
+        MAX(asset_manager->load_callback_cap * 2, 16);
+    asset_manager->load_callbacks = realloc(
+        asset_manager->load_callbacks,
+        asset_manager->load_callback_cap *
+            sizeof(*asset_manager->load_callbacks));
+  }
 
-  asset_manager->count =
-      (index >= asset_manager->count) ? index + 1 : asset_manager->count;
+  asset_manager->load_callbacks[asset_manager->load_callback_count++] =
+      (eg_asset_load_callback_t){asset, routine, args};
+}
+
+static int decode_job(void *args) {
+  asset_load_t *load = args;
+  eg_asset_t *asset  = load->asset;
+
+  load->decoded = EG_ASSET_LOADERS[asset->type].decode(asset);
+
+  // Failures go through the main thread too, so the state only ever changes
+  // there
+  eg_scheduler_add_main_task(load->scheduler, upload_task, load);
+  return 0;
+}
+
+void *eg_asset_manager_load_async(
+    eg_asset_manager_t *asset_manager,
+    eg_task_scheduler_t *scheduler,
+    eg_asset_type_t asset_type,
+    void *options,
+    thrd_start_t routine,
+    void *args) {
+  const eg_asset_loader_t *loader = &EG_ASSET_LOADERS[asset_type];
+  assert(loader->decode != NULL && "asset type can't be loaded asynchronously");
+
+  re_hasher_t hasher = re_hasher_create();
+  re_hash_u32(&hasher, asset_type);
+  const char *path = loader->key(options, &hasher);
+  re_hash_string(&hasher, path);
+
+  re_hash_t hash = re_hasher_get(&hasher);
+  if (hash == 0) hash = 1; // 0 marks empty entries
+
+  mtx_lock(&asset_manager->mutex);
+
+  uint32_t i = source_find(asset_manager, hash, asset_type, path);
+  if (i != UINT32_MAX) {
+    eg_asset_t *asset = asset_manager->sources[i].asset;
+
+    // The last reference might have just been released, with the asset not
+    // unlinked yet. It's only reused while it's still referenced.
+    if (eg_asset_try_retain(asset)) {
+      if (routine != NULL) {
+        add_load_callback(asset_manager, scheduler, asset, routine, args);
+      }
+      mtx_unlock(&asset_manager->mutex);
+      atomic_fetch_add(&asset_manager->load_hits, 1);
+      return asset;
+    }
+
+    source_remove(asset_manager, asset);
+  }
 
-  asset->type  = asset_type;
-  asset->index = index;
-  asset->uid   = uid;
+  // Linked while the mutex is still locked, so that two loads of the same
+  // source can't both miss
+  eg_asset_t *asset = new_asset(
+      asset_manager,
+      asset_type,
+      atomic_fetch_add(&asset_manager->next_uid, 1),
+      EG_ASSET_STATE_PENDING);
+  link_asset(asset_manager, asset);
+  source_insert(asset_manager, hash, path, asset);
 
   mtx_unlock(&asset_manager->mutex);
 
+  atomic_fetch_add(&asset_manager->load_misses, 1);
+
+  loader->begin(asset, options);
+
+  // The load holds its own reference, so the asset can be freed while it's
+  // still loading
+  eg_asset_retain(asset);
+
+  asset_load_t *load  = malloc(sizeof(*load));
+  load->asset_manager = asset_manager;
+  load->scheduler     = scheduler;
+  load->asset         = asset;
+  load->decoded       = NULL;
+  load->routine       = routine;
+  load->args          = args;
+
+  atomic_fetch_add(&asset_manager->pending_loads, 1);
+  eg_scheduler_add_job(
+      scheduler, EG_TASK_PRIORITY_BACKGROUND, NULL, decode_job, load);
+
   return asset;
 }
 
+void eg_asset_manager_wait_for_loads(
+    eg_asset_manager_t *asset_manager, eg_task_scheduler_t *scheduler) {
+  while (atomic_load(&asset_manager->pending_loads) > 0) {
+    if (eg_scheduler_run_main_tasks(scheduler, 1.0) == 0) {
+      thrd_yield();
+    }
+  }
+}
+
 void *eg_asset_manager_get(eg_asset_manager_t *asset_manager, uint32_t index) {
-  return asset_manager->assets[index];
+  _Atomic(eg_asset_t *) *slot = get_slot(asset_manager, index);
+  if (slot == NULL) return NULL;
+
+  return atomic_load_explicit(slot, memory_order_acquire);
 }
 
 void *eg_asset_manager_get_by_uid(
     eg_asset_manager_t *asset_manager, eg_asset_uid_t uid) {
-  for (uint32_t i = 0; i < asset_manager->count; i++) {
-    eg_asset_t *asset = eg_asset_manager_get(asset_manager, i);
-    if (asset != NULL) {
-      if (asset->uid == uid) return asset;
-    }
-  }
+  if (uid == EG_NULL_ASSET_UID) return NULL;
+
+  eg_asset_uid_table_t *table =
+      atomic_load_explicit(&asset_manager->uid_table, memory_order_acquire);
+
+  uint64_t entry;
+  if (uid_find(table, uid, &entry) == UINT32_MAX) return NULL;
 
-  return NULL;
+  // The asset might have been freed since the entry was read, and its slot
+  // given to another asset
+  eg_asset_t *asset = eg_asset_manager_get(asset_manager, entry_index(entry));
+  if (asset == NULL || asset->uid != uid) return NULL;
+
+  return asset;
 }
 
-void eg_asset_manager_free(
-    eg_asset_manager_t *asset_manager, eg_asset_t *asset) {
-  if (asset == NULL) return;
+// Removes the asset from the slots, the UID index and the source table, if
+// it's still there. Called with the mutex locked.
+static void
+unlink_asset(eg_asset_manager_t *asset_manager, eg_asset_t *asset) {
+  source_remove(asset_manager, asset);
+
+  if (asset->index == UINT32_MAX) return;
+
+  uid_remove(asset_manager, asset->uid);
+  atomic_store_explicit(
+      get_slot(asset_manager, asset->index), NULL, memory_order_relaxed);
+
+  asset_manager->free_slots[asset_manager->free_slot_count++] = asset->index;
+  asset->index = UINT32_MAX;
+}
 
+static void
+destroy_asset(eg_asset_manager_t *asset_manager, eg_asset_t *asset) {
   if (asset->name != NULL) free(asset->name);
 
   EG_ASSET_DESTRUCTORS[asset->type](asset);
 
+  eg_asset_pool_t *pool = &asset_manager->pools[asset->type];
+
+  mtx_lock(&pool->mutex);
+  pool_free(pool, asset);
+  mtx_unlock(&pool->mutex);
+}
+
+void eg_asset_manager_free(
+    eg_asset_manager_t *asset_manager, eg_asset_t *asset) {
+  if (asset == NULL) return;
+
+  assert(asset->manager == asset_manager);
+
   mtx_lock(&asset_manager->mutex);
-  fstd_free(&asset_manager->allocator, asset);
-  asset_manager->assets[asset->index] = NULL;
+  unlink_asset(asset_manager, asset);
+  mtx_unlock(&asset_manager->mutex);
 
-  // Shorten the count if possible
-  // TODO: this loop is probably slow
-  uint32_t count = 0;
-  for (uint32_t i = 0; i < asset_manager->count; i++) {
-    if (asset_manager->assets[i] != NULL) {
-      count = i + 1;
+  eg_asset_release(asset);
+}
+
+void eg_asset_retain(eg_asset_t *asset) {
+  if (asset == NULL) return;
+
+  uint32_t ref_count =
+      atomic_fetch_add_explicit(&asset->ref_count, 1, memory_order_relaxed);
+  (void)ref_count;
+  assert(ref_count > 0 && "released assets can only be kept with try_retain");
+}
+
+bool eg_asset_try_retain(eg_asset_t *asset) {
+  if (asset == NULL) return false;
+
+  // Once the count is zero the asset is on the deletion queue, and it must
+  // stay there
+  uint32_t ref_count =
+      atomic_load_explicit(&asset->ref_count, memory_order_relaxed);
+  while (ref_count > 0) {
+    if (atomic_compare_exchange_weak_explicit(
+            &asset->ref_count,
+            &ref_count,
+            ref_count + 1,
+            memory_order_relaxed,
+            memory_order_relaxed)) {
+      return true;
     }
   }
+  return false;
+}
+
+void eg_asset_release(eg_asset_t *asset) {
+  if (asset == NULL) return;
+
+  eg_asset_manager_t *asset_manager = asset->manager;
+
+  // Assets are destroyed in any order then, and the references they hold
+  // might be dangling
+  if (asset_manager->destroying) return;
+
+  uint32_t ref_count =
+      atomic_fetch_sub_explicit(&asset->ref_count, 1, memory_order_acq_rel);
+  if (ref_count != 1) return;
+
+  mtx_lock(&asset_manager->mutex);
+
+  unlink_asset(asset_manager, asset);
+
+  if (asset_manager->deletion_count >= asset_manager->deletion_cap) {
+    asset_manager->deletion_cap = MAX(asset_manager->deletion_cap * 2, 16);
+    asset_manager->deletions = realloc(
+        asset_manager->deletions,
+        asset_manager->deletion_cap * sizeof(*asset_manager->deletions));
+  }
+
+  asset_manager->deletions[asset_manager->deletion_count++] =
+      (eg_asset_deletion_t){asset, asset_manager->frame};
+
+  mtx_unlock(&asset_manager->mutex);
+}
+
+void eg_asset_manager_next_frame(eg_asset_manager_t *asset_manager) {
+  mtx_lock(&asset_manager->mutex);
+
+  asset_manager->frame++;
+
+  free_retired_tables(asset_manager);
+
+  // Deletions are in release order, so the ones that are due come first.
+  // re_window_begin_frame has just waited for the frame submitted
+  // RE_MAX_FRAMES_IN_FLIGHT frames ago, the last one that could use them.
+  uint32_t due = 0;
+  while (due < asset_manager->deletion_count &&
+         asset_manager->frame - asset_manager->deletions[due].frame >=
+             RE_MAX_FRAMES_IN_FLIGHT) {
+    due++;
+  }
+
+  if (due == 0) {
+    mtx_unlock(&asset_manager->mutex);
+    return;
+  }
 
-  asset_manager->count = count;
+  eg_asset_t **assets = malloc(due * sizeof(*assets));
+  for (uint32_t i = 0; i < due; i++) {
+    assets[i] = asset_manager->deletions[i].asset;
+  }
+
+  asset_manager->deletion_count -= due;
+  memmove(
+      asset_manager->deletions,
+      &asset_manager->deletions[due],
+      asset_manager->deletion_count * sizeof(*asset_manager->deletions));
 
   mtx_unlock(&asset_manager->mutex);
+
+  // Destructors release the assets they reference, which need the mutex
+  for (uint32_t i = 0; i < due; i++) {
+    destroy_asset(asset_manager, assets[i]);
+  }
+
+  free(assets);
 }
 
 void eg_asset_manager_destroy(eg_asset_manager_t *asset_manager) {
-  const uint32_t count = asset_manager->count;
+  assert(
+      atomic_load(&asset_manager->pending_loads) == 0 &&
+      "destroying the asset manager with assets still loading");
+
+  VK_CHECK(vkDeviceWaitIdle(g_ctx.device));
 
-  for (uint32_t i = 0; i < count; i++) {
+  asset_manager->destroying = true;
+
+  for (uint32_t i = 0; i < asset_manager->count; i++) {
     eg_asset_t *asset = eg_asset_manager_get(asset_manager, i);
 
     if (asset == NULL) continue;
 
-    eg_asset_manager_free(asset_manager, asset);
+    destroy_asset(asset_manager, asset);
   }
 
-  assert(asset_manager->count == 0);
+  for (uint32_t i = 0; i < asset_manager->deletion_count; i++) {
+    destroy_asset(asset_manager, asset_manager->deletions[i].asset);
+  }
 
   mtx_lock(&asset_manager->mutex);
-  fstd_allocator_destroy(&asset_manager->allocator);
-  free(asset_manager->assets);
+  for (uint32_t i = 0; i < EG_ASSET_TYPE_MAX; i++) {
+    pool_destroy(&asset_manager->pools[i]);
+  }
+  for (uint32_t i = 0; i < asset_manager->segment_count; i++) {
+    free(asset_manager->segments[i]);
+  }
+  free(asset_manager->free_slots);
+
+  for (uint32_t i = 0; i < asset_manager->source_cap; i++) {
+    free(asset_manager->sources[i].path);
+  }
+  free(asset_manager->sources);
+
+  eg_asset_uid_table_t *table = asset_manager->uid_table;
+  while (table != NULL) {
+    eg_asset_uid_table_t *retired = table->retired;
+    free(table);
+    table = retired;
+  }
+
+  free(asset_manager->load_callbacks);
+  free(asset_manager->deletions);
   mtx_unlock(&asset_manager->mutex);
 
   mtx_destroy(&asset_manager->mutex);
@@ -1,23 +1,136 @@
 #pragma once
 
 #include "assets/asset_types.h"
-#include <fstd_alloc.h>
+#include "task_scheduler.h"
 #include <fstd_map.h>
+#include <renderer/hasher.h>
 #include <tinycthread.h>
 
+/*
+ * The slot table grows by adding segments, each twice as big as the previous
+ * one, instead of reallocating. Slots never move, so they can be read without
+ * locking while other threads add assets.
+ */
+#define EG_ASSET_FIRST_SEGMENT_SHIFT 7
+#define EG_ASSET_FIRST_SEGMENT_SIZE (1u << EG_ASSET_FIRST_SEGMENT_SHIFT)
+#define EG_ASSET_MAX_SEGMENTS (32 - EG_ASSET_FIRST_SEGMENT_SHIFT)
+
+/*
+ * Open addressing hash table (with linear probing) from asset UID to slot
+ * index. Each entry packs the index in the high 32 bits and the UID in the low
+ * ones. Empty entries and tombstones (removed entries) have EG_NULL_ASSET_UID
+ * as their UID. Entries never move once written, so lookups can probe the
+ * table while a writer changes it. When assets and tombstones would fill more
+ * than half of it, it's replaced by a new table without the tombstones.
+ */
+typedef struct eg_asset_uid_table_t {
+  uint32_t cap; /* Always a power of two */
+  /* Readers might still be probing the tables that were replaced, so they are
+     only freed by eg_asset_manager_next_frame a frame later */
+  struct eg_asset_uid_table_t *retired;
+  uint64_t retired_frame; /* The manager's frame when it was replaced */
+  _Atomic(uint64_t) entries[];
+} eg_asset_uid_table_t;
+
+/*
+ * Slab allocator for the assets of one type. Assets are carved out of blocks
+ * that are only freed with the manager, and freed assets are linked through
+ * their own memory, so allocating and freeing are O(1).
+ */
+typedef struct eg_asset_pool_t {
+  mtx_t mutex;   /* Per type, so loaders of different types don't contend */
+  size_t stride; /* Size of the type, rounded up to keep assets aligned */
+  uint32_t assets_per_block;
+  char **blocks;
+  uint32_t block_count;
+  void *free; /* Free list */
+} eg_asset_pool_t;
+
+/*
+ * Entry of the table of assets loaded by eg_asset_manager_load_async, keyed by
+ * a hash of the asset type, the source path and the options that change the
+ * result (see eg_asset_loader_t). Loading the same source again returns the
+ * asset that's already there. Open addressing with linear probing like the UID
+ * table, but it's only used with the mutex locked.
+ */
+typedef struct eg_asset_source_t {
+  re_hash_t hash; /* 0 if the entry is empty */
+  char *path;     /* Compared on lookups, in case two keys hash the same */
+  eg_asset_t *asset;
+} eg_asset_source_t;
+
+/* Waits for an asset that was still loading when eg_asset_manager_load_async
+   returned it again */
+typedef struct eg_asset_load_callback_t {
+  eg_asset_t *asset;
+  thrd_start_t routine;
+  void *args;
+} eg_asset_load_callback_t;
+
+typedef struct eg_asset_deletion_t {
+  eg_asset_t *asset;
+  uint64_t frame; /* The manager's frame when the asset was released */
+} eg_asset_deletion_t;
+
 typedef struct eg_asset_manager_t {
+  /* Taken by the threads that add or remove assets. Lookups never take it or
+     wait for writers, see eg_asset_manager_get. */
   mtx_t mutex;
-  fstd_allocator_t allocator;
-  eg_asset_t **assets;
 
-  uint32_t cap;   /* The amount of allocated slots in the `assets` vector */
-  uint32_t count; /* The index of the last asset in the `assets` vector + 1 */
-  eg_asset_uid_t next_uid; /* The last asset UID (incremented after every asset
-                        creation) */
+  eg_asset_pool_t pools[EG_ASSET_TYPE_MAX];
+
+  /* Segment i holds EG_ASSET_FIRST_SEGMENT_SIZE << i slots */
+  _Atomic(_Atomic(eg_asset_t *) *) segments[EG_ASSET_MAX_SEGMENTS];
+  uint32_t segment_count;
+
+  uint32_t cap;      /* The amount of slots in the allocated segments */
+  atomic_uint count; /* High-water mark: slots past it have never been used,
+                        the ones before it are NULL when free */
+
+  /* Stack of the free slots below `count`, reused before growing `count` */
+  uint32_t *free_slots;
+  uint32_t free_slot_count;
+
+  /* The next UID given by eg_asset_manager_alloc */
+  _Atomic(eg_asset_uid_t) next_uid;
+
+  _Atomic(eg_asset_uid_table_t *) uid_table;
+  uint32_t uid_count;
+  uint32_t uid_tombstones; /* Removed entries still in uid_table */
+
+  atomic_uint pending_loads; /* Assets from eg_asset_manager_load_async that
+                                haven't finished loading yet */
+
+  /* See eg_asset_source_t, kept at most half full */
+  eg_asset_source_t *sources;
+  uint32_t source_cap;
+  uint32_t source_count;
+
+  /* Calls to eg_asset_manager_load_async that returned an asset loaded from
+     the same source, and the ones that had to load it */
+  atomic_uint load_hits;
+  atomic_uint load_misses;
+
+  /* Run by the load in flight once it's done, in the order they were added */
+  eg_asset_load_callback_t *load_callbacks;
+  uint32_t load_callback_cap;
+  uint32_t load_callback_count;
+
+  /* Released assets waiting to be destroyed, in release order */
+  eg_asset_deletion_t *deletions;
+  uint32_t deletion_cap;
+  uint32_t deletion_count;
+  uint64_t frame; /* Incremented by eg_asset_manager_next_frame */
+
+  bool destroying; /* Set by eg_asset_manager_destroy, releases are ignored */
 } eg_asset_manager_t;
 
 void eg_asset_manager_init(eg_asset_manager_t *asset_manager);
 
+/*
+ * Assets are created with one reference, owned by the caller, which gives it
+ * up with eg_asset_manager_free.
+ */
 void *eg_asset_manager_alloc(
     eg_asset_manager_t *asset_manager, eg_asset_type_t asset_type);
 
@@ -26,12 +139,82 @@ void *eg_asset_manager_alloc_uid(
     eg_asset_type_t asset_type,
     eg_asset_uid_t uid);
 
+/*
+ * Allocates an asset in the pending state and loads it in the background:
+ * decoding runs as a background job on the scheduler, and the GPU upload runs
+ * on the main thread from eg_scheduler_run_main_tasks. The asset's state then
+ * becomes ready or failed (see eg_asset_is_ready). Only types with a loader in
+ * EG_ASSET_LOADERS can be loaded this way.
+ *
+ * If an asset of the same type was already loaded (or is still loading) from
+ * the same path with the same options, that asset is returned instead, with a
+ * new reference for the caller. Assets that failed to load, or that were
+ * freed, are loaded again.
+ *
+ * `routine` (if not NULL) is called with `args` on the main thread, from
+ * eg_scheduler_run_main_tasks, once the asset's state is ready or failed. That
+ * includes assets that were already loaded or loading.
+ */
+void *eg_asset_manager_load_async(
+    eg_asset_manager_t *asset_manager,
+    eg_task_scheduler_t *scheduler,
+    eg_asset_type_t asset_type,
+    void *options,
+    thrd_start_t routine,
+    void *args);
+
+// Runs main thread tasks until every asynchronous load has finished. Must be
+// called from the main thread.
+void eg_asset_manager_wait_for_loads(
+    eg_asset_manager_t *asset_manager, eg_task_scheduler_t *scheduler);
+
+/*
+ * Lookups don't lock or retry, so they can run on any thread while others add
+ * or free assets without ever waiting for them. An asset that's added or freed
+ * concurrently may or may not be found. One that's freed concurrently stays
+ * valid at least until the next eg_asset_manager_next_frame. To keep it for
+ * longer, another thread than the one that frees assets must use
+ * eg_asset_try_retain: eg_asset_retain would bring back an asset that's
+ * already on the deletion queue. A lookup must not span two calls to
+ * eg_asset_manager_next_frame, which frees the UID tables that were replaced.
+ */
 void *eg_asset_manager_get(eg_asset_manager_t *asset_manager, uint32_t index);
 
 void *eg_asset_manager_get_by_uid(
     eg_asset_manager_t *asset_manager, eg_asset_uid_t uid);
 
+// Removes the asset from the manager, so it can't be found by index or UID
+// anymore, and releases the reference from eg_asset_manager_alloc. The asset
+// itself stays valid until nothing else references it.
 void eg_asset_manager_free(
     eg_asset_manager_t *asset_manager, eg_asset_t *asset);
 
+/*
+ * Whatever keeps a pointer to an asset (components, materials, the scene's
+ * environment) holds a reference to it. Both functions accept NULL.
+ */
+void eg_asset_retain(eg_asset_t *asset);
+
+/*
+ * When the last reference is released the asset goes on a deletion queue.
+ * Command buffers that are still in flight may use it, so it's only destroyed
+ * by eg_asset_manager_next_frame RE_MAX_FRAMES_IN_FLIGHT frames later, without
+ * having to wait for the device. Can be called from any thread.
+ */
+void eg_asset_release(eg_asset_t *asset);
+
+/*
+ * Takes a reference only if the asset still has one, and returns whether it
+ * did. This is the only safe way to keep an asset found by a lookup on a
+ * thread that doesn't own a reference to it, since it may be released
+ * concurrently. Returns false for NULL.
+ */
+bool eg_asset_try_retain(eg_asset_t *asset);
+
+// Must be called once per frame, after re_window_begin_frame has waited for
+// the fence of the frame being reused. Destroys the released assets that no
+// frame in flight can be using anymore.
+void eg_asset_manager_next_frame(eg_asset_manager_t *asset_manager);
+
+// Waits for the device and destroys every asset, referenced or not
 void eg_asset_manager_destroy(eg_asset_manager_t *asset_manager);
@@ -37,6 +37,23 @@ const eg_asset_serializer_t EG_ASSET_SERIALIZERS[] = {EG__ASSETS};
 const eg_asset_deserializer_t EG_ASSET_DESERIALIZERS[] = {EG__ASSETS};
 #undef E
 
+const eg_asset_loader_t EG_ASSET_LOADERS[EG_ASSET_TYPE_MAX] = {
+    [EG_ASSET_TYPE(eg_image_asset_t)] =
+        {
+            .key    = (eg_asset_key_t)eg_image_asset_key,
+            .begin  = (eg_asset_begin_t)eg_image_asset_begin,
+            .decode = (eg_asset_decode_t)eg_image_asset_decode,
+            .upload = (eg_asset_upload_t)eg_image_asset_upload,
+        },
+    [EG_ASSET_TYPE(eg_gltf_asset_t)] =
+        {
+            .key    = (eg_asset_key_t)eg_gltf_asset_key,
+            .begin  = (eg_asset_begin_t)eg_gltf_asset_begin,
+            .decode = (eg_asset_decode_t)eg_gltf_asset_decode,
+            .upload = (eg_asset_upload_t)eg_gltf_asset_upload,
+        },
+};
+
 void eg_asset_set_name(eg_asset_t *asset, const char *name) {
   if (asset->name != NULL) {
     free(asset->name);
@@ -57,3 +74,11 @@ const char *eg_asset_get_name(eg_asset_t *asset) {
 
   return asset->name;
 }
+
+eg_asset_state_t eg_asset_get_state(eg_asset_t *asset) {
+  return atomic_load_explicit(&asset->state, memory_order_acquire);
+}
+
+bool eg_asset_is_ready(eg_asset_t *asset) {
+  return asset != NULL && eg_asset_get_state(asset) == EG_ASSET_STATE_READY;
+}
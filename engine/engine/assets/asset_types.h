@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -7,6 +9,7 @@ typedef struct eg_inspector_t eg_inspector_t;
 typedef struct eg_asset_manager_t eg_asset_manager_t;
 typedef struct eg_serializer_t eg_serializer_t;
 typedef struct eg_deserializer_t eg_deserializer_t;
+typedef struct re_hasher_t re_hasher_t;
 
 extern const char *const EG_DEFAULT_ASSET_NAME;
 
@@ -18,6 +21,32 @@ typedef void (*eg_asset_destructor_t)(void *);
 typedef void (*eg_asset_serializer_t)(void *, eg_serializer_t *);
 typedef void (*eg_asset_deserializer_t)(void *, eg_deserializer_t *);
 
+/*
+ * An asset's init function split in three, so that it can be loaded with
+ * eg_asset_manager_load_async:
+ *  - begin copies what it needs from the options into the asset, on the
+ *    calling thread
+ *  - decode does the CPU heavy part (reading, parsing, decompressing) on a
+ *    worker, and returns the decoded data, or NULL if loading failed
+ *  - upload creates the GPU resources from the decoded data and frees it, on
+ *    the main thread
+ *
+ * key returns the path the options load from, and hashes the rest of the
+ * options that change the result, so the manager can tell when an asset has
+ * already been loaded.
+ */
+typedef const char *(*eg_asset_key_t)(void *options, re_hasher_t *hasher);
+typedef void (*eg_asset_begin_t)(void *, void *options);
+typedef void *(*eg_asset_decode_t)(void *);
+typedef void (*eg_asset_upload_t)(void *, void *decoded);
+
+typedef struct eg_asset_loader_t {
+  eg_asset_key_t key;
+  eg_asset_begin_t begin;
+  eg_asset_decode_t decode;
+  eg_asset_upload_t upload;
+} eg_asset_loader_t;
+
 #define EG_ASSET_TYPE(type) EG_ASSET_TYPE_##type
 #define EG_ASSET_NAME(type) EG_ASSET_NAMES[EG_ASSET_TYPE(type)]
 
@@ -64,6 +93,14 @@ extern const eg_asset_inspector_t EG_ASSET_INSPECTORS[EG_ASSET_TYPE_MAX];
 extern const eg_asset_destructor_t EG_ASSET_DESTRUCTORS[EG_ASSET_TYPE_MAX];
 extern const eg_asset_serializer_t EG_ASSET_SERIALIZERS[EG_ASSET_TYPE_MAX];
 extern const eg_asset_deserializer_t EG_ASSET_DESERIALIZERS[EG_ASSET_TYPE_MAX];
+// Zeroed for the types that can only be loaded synchronously
+extern const eg_asset_loader_t EG_ASSET_LOADERS[EG_ASSET_TYPE_MAX];
+
+typedef enum eg_asset_state_t {
+  EG_ASSET_STATE_PENDING, // Still being loaded by eg_asset_manager_load_async
+  EG_ASSET_STATE_READY,
+  EG_ASSET_STATE_FAILED,
+} eg_asset_state_t;
 
 typedef struct eg_asset_t {
   eg_asset_type_t type;
@@ -71,8 +108,19 @@ typedef struct eg_asset_t {
       uid; /* not associated with asset's position in the asset_manager */
   uint32_t index;
   char *name;
+  _Atomic(eg_asset_state_t) state;
+  atomic_uint ref_count; /* See eg_asset_retain */
+  eg_asset_manager_t *manager;
+  uint64_t source_hash; /* Key in the manager's source table, 0 if it's not
+                           there */
 } eg_asset_t;
 
 void eg_asset_set_name(eg_asset_t *asset, const char *name);
 
 const char *eg_asset_get_name(eg_asset_t *asset);
+
+eg_asset_state_t eg_asset_get_state(eg_asset_t *asset);
+
+// Whether the asset has finished loading and can be used. NULL is never ready,
+// so callers can fall back to a default in both cases.
+bool eg_asset_is_ready(eg_asset_t *asset);
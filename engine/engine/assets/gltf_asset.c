@@ -6,11 +6,14 @@
 #include "../filesystem.h"
 #include "../imgui.h"
 #include "../serializer.h"
+#include "../task_scheduler.h"
+#include "../util.h"
 #include <assert.h>
 #include <cgltf.h>
 #include <float.h>
 #include <fstd_util.h>
 #include <renderer/context.h>
+#include <renderer/hasher.h>
 #include <renderer/util.h>
 #include <stb_image.h>
 #include <stdlib.h>
@@ -492,7 +495,38 @@ static void get_scene_dimensions(eg_gltf_asset_t *model) {
       vec3_distance(model->dimensions.min, model->dimensions.max) / 2.0f;
 }
 
-void eg_gltf_asset_init(
+typedef struct decoded_gltf_image_t {
+  uint8_t *pixels; // RGBA8
+  uint32_t width;
+  uint32_t height;
+} decoded_gltf_image_t;
+
+typedef struct decoded_gltf_t {
+  decoded_gltf_image_t *images;
+  re_vertex_t *vertices;
+  uint32_t *indices;
+} decoded_gltf_t;
+
+static void decoded_gltf_free(decoded_gltf_t *decoded, uint32_t image_count) {
+  if (decoded->images != NULL) {
+    for (uint32_t i = 0; i < image_count; i++) {
+      free(decoded->images[i].pixels);
+    }
+    free(decoded->images);
+  }
+
+  free(decoded->vertices);
+  free(decoded->indices);
+  free(decoded);
+}
+
+const char *
+eg_gltf_asset_key(eg_gltf_asset_options_t *options, re_hasher_t *hasher) {
+  re_hash_u32(hasher, options->flip_uvs);
+  return options->path;
+}
+
+void eg_gltf_asset_begin(
     eg_gltf_asset_t *model, eg_gltf_asset_options_t *options) {
   model->path     = strdup(options->path);
   model->flip_uvs = options->flip_uvs;
@@ -513,9 +547,14 @@ void eg_gltf_asset_init(
   model->mesh_count = 0;
 
   dimensions_init(&model->dimensions);
+}
 
-  eg_file_t *gltf_file = eg_file_open_read(options->path);
-  assert(gltf_file);
+void *eg_gltf_asset_decode(eg_gltf_asset_t *model) {
+  eg_file_t *gltf_file = eg_file_open_read(model->path);
+  if (gltf_file == NULL) {
+    EG_LOG_ERROR("Failed to open glTF model: %s", model->path);
+    return NULL;
+  }
   size_t gltf_size = eg_file_size(gltf_file);
   assert(gltf_size > 0);
   unsigned char *gltf_data = calloc(1, gltf_size);
@@ -526,16 +565,24 @@ void eg_gltf_asset_init(
   cgltf_options gltf_options = {0};
   cgltf_data *data           = NULL;
   cgltf_result result = cgltf_parse(&gltf_options, gltf_data, gltf_size, &data);
-  assert(result == cgltf_result_success);
+  if (result == cgltf_result_success) {
+    result = cgltf_load_buffers(&gltf_options, data, model->path);
+  }
 
-  result = cgltf_load_buffers(&gltf_options, data, options->path);
-  assert(result == cgltf_result_success);
+  if (result != cgltf_result_success ||
+      data->file_type != cgltf_file_type_glb) {
+    EG_LOG_ERROR("Failed to parse glTF model: %s", model->path);
+    if (data != NULL) cgltf_free(data);
+    free(gltf_data);
+    return NULL;
+  }
 
-  assert(data->file_type == cgltf_file_type_glb);
+  decoded_gltf_t *decoded = calloc(1, sizeof(*decoded));
 
-  // Load images
+  // Decode images
   model->image_count = (uint32_t)data->images_count;
   model->images      = calloc(model->image_count, sizeof(*model->images));
+  decoded->images    = calloc(model->image_count, sizeof(*decoded->images));
   for (uint32_t i = 0; i < model->image_count; i++) {
     cgltf_image *image = &data->images[i];
     unsigned char *buffer_data =
@@ -547,30 +594,24 @@ void eg_gltf_asset_init(
     unsigned char *image_data = stbi_load_from_memory(
         buffer_data, (int)buffer_size, &width, &height, &n_channels, 4);
 
-    assert(image_data != NULL);
+    if (image_data == NULL) {
+      EG_LOG_ERROR("Failed to decode image %u of %s", i, model->path);
+      decoded_gltf_free(decoded, model->image_count);
+      cgltf_free(data);
+      free(gltf_data);
+      return NULL;
+    }
 
-    re_image_options_t image_options = {
-        .width           = (uint32_t)width,
-        .height          = (uint32_t)height,
-        .layer_count     = 1,
-        .mip_level_count = 1,
-        .format          = VK_FORMAT_R8G8B8A8_UNORM,
-        .flags           = RE_IMAGE_FLAG_ANISOTROPY,
-        .usage           = RE_IMAGE_USAGE_SAMPLED | RE_IMAGE_USAGE_TRANSFER_DST,
+    decoded->images[i] = (decoded_gltf_image_t){
+        .pixels = image_data,
+        .width  = (uint32_t)width,
+        .height = (uint32_t)height,
     };
 
-    re_image_init(&model->images[i], &image_options);
-
-    re_image_upload(
-        &model->images[i],
-        g_ctx.transient_command_pool,
-        image_data,
-        (uint32_t)width,
-        (uint32_t)height,
-        0,
-        0);
-
-    free(image_data);
+    // Images are the slowest part, so let other tasks run between them
+    if (eg_in_job()) {
+      eg_job_yield();
+    }
   }
 
   // Load materials
@@ -636,10 +677,8 @@ void eg_gltf_asset_init(
   model->mesh_count = (uint32_t)data->meshes_count;
   model->meshes     = calloc(model->mesh_count, sizeof(*model->meshes));
 
-  re_vertex_t *vertices = NULL;
-  model->vertex_count   = 0;
-  uint32_t *indices     = NULL;
-  model->index_count    = 0;
+  model->vertex_count = 0;
+  model->index_count  = 0;
 
   for (size_t i = 0; i < data->scene->nodes_count; i++) {
     load_node(
@@ -647,11 +686,11 @@ void eg_gltf_asset_init(
         NULL,
         data->scene->nodes[i],
         data,
-        &vertices,
+        &decoded->vertices,
         &model->vertex_count,
-        &indices,
+        &decoded->indices,
         &model->index_count,
-        options->flip_uvs);
+        model->flip_uvs);
   }
 
   for (size_t i = 0; i < data->scene->nodes_count; i++) {
@@ -660,6 +699,42 @@ void eg_gltf_asset_init(
     }
   }
 
+  get_scene_dimensions(model);
+
+  cgltf_free(data);
+  free(gltf_data);
+
+  return decoded;
+}
+
+void eg_gltf_asset_upload(eg_gltf_asset_t *model, void *data) {
+  decoded_gltf_t *decoded = data;
+
+  for (uint32_t i = 0; i < model->image_count; i++) {
+    decoded_gltf_image_t *image = &decoded->images[i];
+
+    re_image_options_t image_options = {
+        .width           = image->width,
+        .height          = image->height,
+        .layer_count     = 1,
+        .mip_level_count = 1,
+        .format          = VK_FORMAT_R8G8B8A8_UNORM,
+        .flags           = RE_IMAGE_FLAG_ANISOTROPY,
+        .usage           = RE_IMAGE_USAGE_SAMPLED | RE_IMAGE_USAGE_TRANSFER_DST,
+    };
+
+    re_image_init(&model->images[i], &image_options);
+
+    re_image_upload(
+        &model->images[i],
+        g_ctx.transient_command_pool,
+        image->pixels,
+        image->width,
+        image->height,
+        0,
+        0);
+  }
+
   // Vertex and index buffers
   size_t vertex_buffer_size = model->vertex_count * sizeof(re_vertex_t);
   size_t index_buffer_size  = model->index_count * sizeof(uint32_t);
@@ -695,14 +770,14 @@ void eg_gltf_asset_init(
           .size   = index_buffer_size,
       });
 
-  memcpy(staging_memory_ptr, vertices, vertex_buffer_size);
+  memcpy(staging_memory_ptr, decoded->vertices, vertex_buffer_size);
   re_buffer_transfer_to_buffer(
       &staging_buffer,
       &model->vertex_buffer,
       g_ctx.transient_command_pool,
       vertex_buffer_size);
 
-  memcpy(staging_memory_ptr, indices, index_buffer_size);
+  memcpy(staging_memory_ptr, decoded->indices, index_buffer_size);
   re_buffer_transfer_to_buffer(
       &staging_buffer,
       &model->index_buffer,
@@ -712,18 +787,23 @@ void eg_gltf_asset_init(
   re_buffer_unmap_memory(&staging_buffer);
   re_buffer_destroy(&staging_buffer);
 
-  // TODO: get scene dimensions
-  get_scene_dimensions(model);
+  decoded_gltf_free(decoded, model->image_count);
+}
 
-  cgltf_free(data);
-  free(gltf_data);
+void eg_gltf_asset_init(
+    eg_gltf_asset_t *model, eg_gltf_asset_options_t *options) {
+  eg_gltf_asset_begin(model, options);
 
-  if (vertices != NULL) {
-    free(vertices);
-  }
-  if (indices != NULL) {
-    free(indices);
+  void *decoded = eg_gltf_asset_decode(model);
+  if (decoded == NULL) {
+    // The decoder already logged why, leave the asset failed like the async
+    // path does
+    atomic_store_explicit(
+        &model->asset.state, EG_ASSET_STATE_FAILED, memory_order_release);
+    return;
   }
+
+  eg_gltf_asset_upload(model, decoded);
 }
 
 void eg_gltf_asset_destroy(eg_gltf_asset_t *model) {
@@ -98,3 +98,16 @@ void eg_gltf_asset_serialize(
 
 void eg_gltf_asset_deserialize(
     eg_gltf_asset_t *model, eg_deserializer_t *deserializer);
+
+/*
+ * Asynchronous loading, see eg_asset_loader_t
+ */
+const char *
+eg_gltf_asset_key(eg_gltf_asset_options_t *options, re_hasher_t *hasher);
+
+void eg_gltf_asset_begin(
+    eg_gltf_asset_t *model, eg_gltf_asset_options_t *options);
+
+void *eg_gltf_asset_decode(eg_gltf_asset_t *model);
+
+void eg_gltf_asset_upload(eg_gltf_asset_t *model, void *decoded);
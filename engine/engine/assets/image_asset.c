@@ -9,6 +9,7 @@
 #include "../util/tinyktx.h"
 #include <assert.h>
 #include <renderer/context.h>
+#include <renderer/hasher.h>
 #include <stb_image.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -79,97 +80,173 @@ void eg_image_asset_destroy(eg_image_asset_t *image) {
   }
 }
 
-void eg_image_asset_init(
-    eg_image_asset_t *image, eg_image_asset_options_t *options) {
-  char ext[128] = "";
-  get_ext(options->path, ext);
+typedef struct decoded_image_t {
+  re_image_options_t options;
 
-  if (strcmp(ext, "ktx") == 0) {
-    ktx_data_t ktx_data;
-    ktx_result_t ktx_result;
+  bool is_ktx;
+  ktx_data_t ktx_data;
+  uint8_t *pixels; // RGBA8 pixels from stb_image, if not KTX
+} decoded_image_t;
 
-    eg_file_t *file = eg_file_open_read(options->path);
-    assert(file);
-    size_t raw_data_size = eg_file_size(file);
-    uint8_t *raw_data    = calloc(1, raw_data_size);
-    eg_file_read_bytes(file, raw_data, raw_data_size);
-    eg_file_close(file);
+static uint8_t *read_file(const char *path, size_t *size) {
+  eg_file_t *file = eg_file_open_read(path);
+  if (file == NULL) {
+    return NULL;
+  }
 
-    ktx_result = ktx_read(raw_data, raw_data_size, &ktx_data);
-    assert(KTX_SUCCESS == ktx_result);
+  *size         = eg_file_size(file);
+  uint8_t *data = calloc(1, *size);
+  eg_file_read_bytes(file, data, *size);
+  eg_file_close(file);
 
-    VkFormat format;
+  return data;
+}
 
-    switch (ktx_data.internal_format) {
-    case KTX_RGBA16F: {
-      format = VK_FORMAT_R16G16B16A16_SFLOAT;
-      break;
-    }
-    default: {
-      EG_LOG_FATAL(
-          "Unsupported KTX internal format: %u", ktx_data.internal_format);
-      assert(0);
-      break;
-    }
-    }
+static bool decode_ktx(const char *path, decoded_image_t *decoded) {
+  size_t raw_data_size;
+  uint8_t *raw_data = read_file(path, &raw_data_size);
+  if (raw_data == NULL) {
+    EG_LOG_ERROR("Failed to open image: %s", path);
+    return false;
+  }
 
-    image->path = strdup(options->path);
+  // On success, the KTX data owns raw_data
+  if (ktx_read(raw_data, raw_data_size, &decoded->ktx_data) != KTX_SUCCESS) {
+    EG_LOG_ERROR("Failed to read KTX image: %s", path);
+    free(raw_data);
+    return false;
+  }
 
-    re_image_init(
-        &image->image,
-        &(re_image_options_t){
-            .width           = ktx_data.pixel_width,
-            .height          = ktx_data.pixel_height,
-            .layer_count     = ktx_data.face_count,
-            .mip_level_count = ktx_data.mipmap_level_count,
-            .format          = format,
-            .usage = RE_IMAGE_USAGE_SAMPLED | RE_IMAGE_USAGE_TRANSFER_DST,
-        });
+  VkFormat format;
+
+  switch (decoded->ktx_data.internal_format) {
+  case KTX_RGBA16F: {
+    format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    break;
+  }
+  default: {
+    EG_LOG_ERROR(
+        "Unsupported KTX internal format: %u",
+        decoded->ktx_data.internal_format);
+    ktx_data_destroy(&decoded->ktx_data);
+    return false;
+  }
+  }
 
-    upload_ktx(&image->image, g_ctx.transient_command_pool, &ktx_data);
+  decoded->is_ktx  = true;
+  decoded->options = (re_image_options_t){
+      .width           = decoded->ktx_data.pixel_width,
+      .height          = decoded->ktx_data.pixel_height,
+      .layer_count     = decoded->ktx_data.face_count,
+      .mip_level_count = decoded->ktx_data.mipmap_level_count,
+      .format          = format,
+      .usage           = RE_IMAGE_USAGE_SAMPLED | RE_IMAGE_USAGE_TRANSFER_DST,
+  };
+
+  return true;
+}
 
-    ktx_data_destroy(&ktx_data);
+static bool decode_stb(const char *path, decoded_image_t *decoded) {
+  size_t raw_data_size;
+  uint8_t *raw_data = read_file(path, &raw_data_size);
+  if (raw_data == NULL) {
+    EG_LOG_ERROR("Failed to open image: %s", path);
+    return false;
   }
 
-  if (strcmp(ext, "png") == 0 || strcmp(ext, "jpeg") == 0 ||
-      strcmp(ext, "jpg") == 0) {
+  int width, height, channels;
+  decoded->pixels = stbi_load_from_memory(
+      raw_data, (int)raw_data_size, &width, &height, &channels, 4);
 
-    eg_file_t *file = eg_file_open_read(options->path);
-    assert(file);
-    size_t raw_data_size = eg_file_size(file);
-    uint8_t *raw_data    = calloc(1, raw_data_size);
-    eg_file_read_bytes(file, raw_data, raw_data_size);
-    eg_file_close(file);
+  free(raw_data);
 
-    int width, height, channels;
-    uint8_t *data = stbi_load_from_memory(
-        raw_data, (int)raw_data_size, &width, &height, &channels, 4);
+  if (decoded->pixels == NULL) {
+    EG_LOG_ERROR("Failed to decode image: %s", path);
+    return false;
+  }
 
-    assert(data != NULL);
+  decoded->is_ktx  = false;
+  decoded->options = (re_image_options_t){
+      .width  = (uint32_t)width,
+      .height = (uint32_t)height,
+      .usage  = RE_IMAGE_USAGE_SAMPLED | RE_IMAGE_USAGE_TRANSFER_DST,
+  };
 
-    free(raw_data);
+  return true;
+}
 
-    image->path = strdup(options->path);
+const char *
+eg_image_asset_key(eg_image_asset_options_t *options, re_hasher_t *hasher) {
+  return options->path;
+}
 
-    re_image_init(
-        &image->image,
-        &(re_image_options_t){
-            .width  = (uint32_t)width,
-            .height = (uint32_t)height,
-            .usage  = RE_IMAGE_USAGE_SAMPLED | RE_IMAGE_USAGE_TRANSFER_DST,
-        });
+void eg_image_asset_begin(
+    eg_image_asset_t *image, eg_image_asset_options_t *options) {
+  image->path = strdup(options->path);
+}
+
+void *eg_image_asset_decode(eg_image_asset_t *image) {
+  char ext[128] = "";
+  get_ext(image->path, ext);
 
+  decoded_image_t *decoded = calloc(1, sizeof(*decoded));
+  bool ok                  = false;
+
+  if (strcmp(ext, "ktx") == 0) {
+    ok = decode_ktx(image->path, decoded);
+  } else if (
+      strcmp(ext, "png") == 0 || strcmp(ext, "jpeg") == 0 ||
+      strcmp(ext, "jpg") == 0) {
+    ok = decode_stb(image->path, decoded);
+  } else {
+    EG_LOG_ERROR("Unsupported image extension: %s", image->path);
+  }
+
+  if (!ok) {
+    free(decoded);
+    return NULL;
+  }
+
+  return decoded;
+}
+
+void eg_image_asset_upload(eg_image_asset_t *image, void *data) {
+  decoded_image_t *decoded = data;
+
+  re_image_init(&image->image, &decoded->options);
+
+  if (decoded->is_ktx) {
+    upload_ktx(&image->image, g_ctx.transient_command_pool, &decoded->ktx_data);
+    ktx_data_destroy(&decoded->ktx_data);
+  } else {
     re_image_upload(
         &image->image,
         g_ctx.transient_command_pool,
-        data,
-        (uint32_t)width,
-        (uint32_t)height,
+        decoded->pixels,
+        decoded->options.width,
+        decoded->options.height,
         0,
         0);
+    free(decoded->pixels);
+  }
 
-    free(data);
+  free(decoded);
+}
+
+void eg_image_asset_init(
+    eg_image_asset_t *image, eg_image_asset_options_t *options) {
+  eg_image_asset_begin(image, options);
+
+  void *decoded = eg_image_asset_decode(image);
+  if (decoded == NULL) {
+    // The decoder already logged why, leave the asset failed like the async
+    // path does
+    atomic_store_explicit(
+        &image->asset.state, EG_ASSET_STATE_FAILED, memory_order_release);
+    return;
   }
+
+  eg_image_asset_upload(image, decoded);
 }
 
 enum {
@@ -32,3 +32,16 @@ void eg_image_asset_serialize(
 
 void eg_image_asset_deserialize(
     eg_image_asset_t *image, eg_deserializer_t *deserializer);
+
+/*
+ * Asynchronous loading, see eg_asset_loader_t
+ */
+const char *
+eg_image_asset_key(eg_image_asset_options_t *options, re_hasher_t *hasher);
+
+void eg_image_asset_begin(
+    eg_image_asset_t *image, eg_image_asset_options_t *options);
+
+void *eg_image_asset_decode(eg_image_asset_t *image);
+
+void eg_image_asset_upload(eg_image_asset_t *image, void *decoded);
@@ -25,6 +25,12 @@ void eg_pbr_material_asset_init(
   material->occlusion_texture          = options->occlusion_texture;
   material->metallic_roughness_texture = options->metallic_roughness_texture;
   material->emissive_texture           = options->emissive_texture;
+
+  eg_asset_retain((eg_asset_t *)material->albedo_texture);
+  eg_asset_retain((eg_asset_t *)material->normal_texture);
+  eg_asset_retain((eg_asset_t *)material->occlusion_texture);
+  eg_asset_retain((eg_asset_t *)material->metallic_roughness_texture);
+  eg_asset_retain((eg_asset_t *)material->emissive_texture);
 }
 
 void eg_pbr_material_asset_inspect(
@@ -43,7 +49,13 @@ void eg_pbr_material_asset_inspect(
   igColorEdit4("Emissive factor", &material->uniform.emissive_factor.x, 0);
 }
 
-void eg_pbr_material_asset_destroy(eg_pbr_material_asset_t *material) {}
+void eg_pbr_material_asset_destroy(eg_pbr_material_asset_t *material) {
+  eg_asset_release((eg_asset_t *)material->albedo_texture);
+  eg_asset_release((eg_asset_t *)material->normal_texture);
+  eg_asset_release((eg_asset_t *)material->occlusion_texture);
+  eg_asset_release((eg_asset_t *)material->metallic_roughness_texture);
+  eg_asset_release((eg_asset_t *)material->emissive_texture);
+}
 
 enum {
   PROP_UNIFORM,
@@ -158,15 +170,16 @@ void eg_pbr_material_asset_bind(
   re_image_t *occlusion          = &g_eng.white_texture;
   re_image_t *emissive           = &g_eng.black_texture;
 
-  if (material->albedo_texture != NULL)
+  // Textures that are missing or still loading keep the defaults
+  if (eg_asset_is_ready((eg_asset_t *)material->albedo_texture))
     albedo = &material->albedo_texture->image;
-  if (material->normal_texture != NULL)
+  if (eg_asset_is_ready((eg_asset_t *)material->normal_texture))
     normal = &material->normal_texture->image;
-  if (material->metallic_roughness_texture != NULL)
+  if (eg_asset_is_ready((eg_asset_t *)material->metallic_roughness_texture))
     metallic_roughness = &material->metallic_roughness_texture->image;
-  if (material->occlusion_texture != NULL)
+  if (eg_asset_is_ready((eg_asset_t *)material->occlusion_texture))
     occlusion = &material->occlusion_texture->image;
-  if (material->emissive_texture != NULL)
+  if (eg_asset_is_ready((eg_asset_t *)material->emissive_texture))
     emissive = &material->emissive_texture->image;
 
   re_cmd_bind_image(cmd_buffer, set, 0, albedo);
@@ -176,7 +189,7 @@ void eg_pbr_material_asset_bind(
   re_cmd_bind_image(cmd_buffer, set, 4, emissive);
 
   material->uniform.has_normal_texture =
-      (material->normal_texture != NULL) ? 1 : 0;
+      (normal != &g_eng.white_texture) ? 1 : 0;
 
   void *mapping =
       re_cmd_bind_uniform(cmd_buffer, set, 5, sizeof(material->uniform));
@@ -1,6 +1,7 @@
 #include "comp_types.h"
 
 #include "gltf_comp.h"
+#include "hierarchy_comp.h"
 #include "mesh_comp.h"
 #include "point_light_comp.h"
 #include "renderable_comp.h"
@@ -8,47 +9,116 @@
 #include "transform_comp.h"
 
 #define E(                                                                     \
-    t, initializer, inspector, destructor, serializer, deserializer, name)     \
+    t,                                                                         \
+    initializer,                                                               \
+    inspector,                                                                 \
+    destructor,                                                                \
+    serializer,                                                                \
+    deserializer,                                                              \
+    name,                                                                      \
+    storage)                                                                   \
   sizeof(t),
 const size_t EG_COMP_SIZES[] = {EG__COMPS};
 #undef E
 
 #define E(                                                                     \
-    t, initializer, inspector, destructor, serializer, deserializer, name)     \
+    t,                                                                         \
+    initializer,                                                               \
+    inspector,                                                                 \
+    destructor,                                                                \
+    serializer,                                                                \
+    deserializer,                                                              \
+    name,                                                                      \
+    storage)                                                                   \
   name,
 const char *EG_COMP_NAMES[] = {EG__COMPS};
 #undef E
 
 #define E(                                                                     \
-    t, initializer, inspector, destructor, serializer, deserializer, name)     \
+    t,                                                                         \
+    initializer,                                                               \
+    inspector,                                                                 \
+    destructor,                                                                \
+    serializer,                                                                \
+    deserializer,                                                              \
+    name,                                                                      \
+    storage)                                                                   \
   ((eg_comp_initializer_t)initializer),
 const eg_comp_initializer_t EG_COMP_INITIALIZERS[] = {EG__COMPS};
 #undef E
 
 #define E(                                                                     \
-    t, initializer, inspector, destructor, serializer, deserializer, name)     \
+    t,                                                                         \
+    initializer,                                                               \
+    inspector,                                                                 \
+    destructor,                                                                \
+    serializer,                                                                \
+    deserializer,                                                              \
+    name,                                                                      \
+    storage)                                                                   \
   ((eg_comp_inspector_t)inspector),
 const eg_comp_inspector_t EG_COMP_INSPECTORS[] = {EG__COMPS};
 #undef E
 
 #define E(                                                                     \
-    t, initializer, inspector, destructor, serializer, deserializer, name)     \
+    t,                                                                         \
+    initializer,                                                               \
+    inspector,                                                                 \
+    destructor,                                                                \
+    serializer,                                                                \
+    deserializer,                                                              \
+    name,                                                                      \
+    storage)                                                                   \
   ((eg_comp_destructor_t)destructor),
 const eg_comp_destructor_t EG_COMP_DESTRUCTORS[] = {EG__COMPS};
 #undef E
 
 #define E(                                                                     \
-    t, initializer, inspector, destructor, serializer, deserializer, name)     \
+    t,                                                                         \
+    initializer,                                                               \
+    inspector,                                                                 \
+    destructor,                                                                \
+    serializer,                                                                \
+    deserializer,                                                              \
+    name,                                                                      \
+    storage)                                                                   \
   ((eg_comp_serializer_t)serializer),
 const eg_comp_serializer_t EG_COMP_SERIALIZERS[] = {EG__COMPS};
 #undef E
 
 #define E(                                                                     \
-    t, initializer, inspector, destructor, serializer, deserializer, name)     \
+    t,                                                                         \
+    initializer,                                                               \
+    inspector,                                                                 \
+    destructor,                                                                \
+    serializer,                                                                \
+    deserializer,                                                              \
+    name,                                                                      \
+    storage)                                                                   \
   ((eg_comp_deserializer_t)deserializer),
 const eg_comp_deserializer_t EG_COMP_DESERIALIZERS[] = {EG__COMPS};
 #undef E
 
+#define E(                                                                     \
+    t,                                                                         \
+    initializer,                                                               \
+    inspector,                                                                 \
+    destructor,                                                                \
+    serializer,                                                                \
+    deserializer,                                                              \
+    name,                                                                      \
+    storage)                                                                   \
+  storage,
+const eg_comp_storage_t EG_COMP_STORAGES[] = {EG__COMPS};
+#undef E
+
+const eg_comp_retainer_t EG_COMP_RETAINERS[EG_COMP_TYPE_MAX] = {
+    [EG_COMP_TYPE(eg_renderable_comp_t)] =
+        (eg_comp_retainer_t)eg_renderable_comp_retain,
+    [EG_COMP_TYPE(eg_mesh_comp_t)] = (eg_comp_retainer_t)eg_mesh_comp_retain,
+    [EG_COMP_TYPE(eg_gltf_comp_t)] = (eg_comp_retainer_t)eg_gltf_comp_retain,
+};
+
 #define E(enum_name, name) name,
 const char *EG_TAG_NAMES[] = {EG__TAGS};
 #undef E
@@ -15,6 +15,17 @@ typedef void (*eg_comp_initializer_t)(void *);
 typedef void (*eg_comp_inspector_t)(void *, eg_inspector_t *);
 typedef void (*eg_comp_serializer_t)(void *, eg_serializer_t *);
 typedef void (*eg_comp_deserializer_t)(void *, eg_deserializer_t *);
+typedef void (*eg_comp_retainer_t)(void *);
+
+typedef enum eg_comp_storage_t {
+  // One slot per entity, indexed by entity index. Best for components that
+  // most entities have.
+  EG_COMP_STORAGE_DENSE,
+  // Sparse set: components are packed in a dense array, with a map from entity
+  // index to dense index. Best for components that few entities have, since
+  // they can be iterated without touching the other entities.
+  EG_COMP_STORAGE_SPARSE,
+} eg_comp_storage_t;
 
 #define EG_COMP_TYPE(comp) EG_COMP_TYPE_##comp
 #define EG_COMP_NAME(comp) EG_COMP_NAMES[EG_COMP_TYPE(comp)]
@@ -26,47 +37,68 @@ typedef void (*eg_comp_deserializer_t)(void *, eg_deserializer_t *);
     eg_transform_comp_destroy,                                                 \
     eg_transform_comp_serialize,                                               \
     eg_transform_comp_deserialize,                                             \
-    "Transform")                                                               \
+    "Transform",                                                               \
+    EG_COMP_STORAGE_DENSE)                                                     \
   E(eg_point_light_comp_t,                                                     \
     eg_point_light_comp_default,                                               \
     eg_point_light_comp_inspect,                                               \
     eg_point_light_comp_destroy,                                               \
     eg_point_light_comp_serialize,                                             \
     eg_point_light_comp_deserialize,                                           \
-    "Point Light")                                                             \
+    "Point Light",                                                             \
+    EG_COMP_STORAGE_SPARSE)                                                    \
   E(eg_renderable_comp_t,                                                      \
     eg_renderable_comp_default,                                                \
     eg_renderable_comp_inspect,                                                \
     eg_renderable_comp_destroy,                                                \
     eg_renderable_comp_serialize,                                              \
     eg_renderable_comp_deserialize,                                            \
-    "Renderable")                                                              \
+    "Renderable",                                                              \
+    EG_COMP_STORAGE_DENSE)                                                     \
   E(eg_mesh_comp_t,                                                            \
     eg_mesh_comp_default,                                                      \
     eg_mesh_comp_inspect,                                                      \
     eg_mesh_comp_destroy,                                                      \
     eg_mesh_comp_serialize,                                                    \
     eg_mesh_comp_deserialize,                                                  \
-    "Mesh")                                                                    \
+    "Mesh",                                                                    \
+    EG_COMP_STORAGE_DENSE)                                                     \
   E(eg_gltf_comp_t,                                                            \
     eg_gltf_comp_default,                                                      \
     eg_gltf_comp_inspect,                                                      \
     eg_gltf_comp_destroy,                                                      \
     eg_gltf_comp_serialize,                                                    \
     eg_gltf_comp_deserialize,                                                  \
-    "GLTF Model")                                                              \
+    "GLTF Model",                                                              \
+    EG_COMP_STORAGE_DENSE)                                                     \
   E(eg_terrain_comp_t,                                                         \
     eg_terrain_comp_default,                                                   \
     eg_terrain_comp_inspect,                                                   \
     eg_terrain_comp_destroy,                                                   \
     eg_terrain_comp_serialize,                                                 \
     eg_terrain_comp_deserialize,                                               \
-    "Terrain")
+    "Terrain",                                                                 \
+    EG_COMP_STORAGE_SPARSE)                                                    \
+  E(eg_hierarchy_comp_t,                                                       \
+    eg_hierarchy_comp_default,                                                 \
+    eg_hierarchy_comp_inspect,                                                 \
+    eg_hierarchy_comp_destroy,                                                 \
+    eg_hierarchy_comp_serialize,                                               \
+    eg_hierarchy_comp_deserialize,                                             \
+    "Hierarchy",                                                               \
+    EG_COMP_STORAGE_SPARSE)
 
 #define EG__TAGS E(EG_TAG_HIDDEN, "Hidden")
 
 #define E(                                                                     \
-    t, initializer, inspector, destructor, serializer, deserializer, name)     \
+    t,                                                                         \
+    initializer,                                                               \
+    inspector,                                                                 \
+    destructor,                                                                \
+    serializer,                                                                \
+    deserializer,                                                              \
+    name,                                                                      \
+    storage)                                                                   \
   EG_COMP_TYPE(t),
 typedef enum eg_comp_type_t { EG__COMPS EG_COMP_TYPE_MAX } eg_comp_type_t;
 #undef E
@@ -78,6 +110,11 @@ extern const eg_comp_inspector_t EG_COMP_INSPECTORS[EG_COMP_TYPE_MAX];
 extern const eg_comp_destructor_t EG_COMP_DESTRUCTORS[EG_COMP_TYPE_MAX];
 extern const eg_comp_serializer_t EG_COMP_SERIALIZERS[EG_COMP_TYPE_MAX];
 extern const eg_comp_deserializer_t EG_COMP_DESERIALIZERS[EG_COMP_TYPE_MAX];
+extern const eg_comp_storage_t EG_COMP_STORAGES[EG_COMP_TYPE_MAX];
+// Retain the assets a component points to, for copies that hold their own
+// references (which the destructor releases). NULL for the types that don't
+// point to assets.
+extern const eg_comp_retainer_t EG_COMP_RETAINERS[EG_COMP_TYPE_MAX];
 
 #define E(enum_name, name) enum_name,
 typedef enum eg_tag_t { EG__TAGS EG_TAG_MAX } eg_tag_t;
@@ -26,7 +26,10 @@ void eg_gltf_comp_inspect(eg_gltf_comp_t *model, eg_inspector_t *inspector) {
       });
 }
 
-void eg_gltf_comp_destroy(eg_gltf_comp_t *model) {}
+void eg_gltf_comp_destroy(eg_gltf_comp_t *model) {
+  eg_asset_release((eg_asset_t *)model->asset);
+  model->asset = NULL;
+}
 
 enum {
   PROP_GLTF,
@@ -56,6 +59,7 @@ void eg_gltf_comp_deserialize(
       eg_asset_uid_t uid = eg_deserializer_read_u32(deserializer);
       model->asset =
           eg_asset_manager_get_by_uid(deserializer->asset_manager, uid);
+      eg_asset_retain((eg_asset_t *)model->asset);
       break;
     }
     default: break;
@@ -179,6 +183,11 @@ static void draw_node_no_mat(
 
 void eg_gltf_comp_init(eg_gltf_comp_t *model, eg_gltf_asset_t *asset) {
   model->asset = asset;
+  eg_asset_retain((eg_asset_t *)asset);
+}
+
+void eg_gltf_comp_retain(eg_gltf_comp_t *model) {
+  eg_asset_retain((eg_asset_t *)model->asset);
 }
 
 void eg_gltf_comp_draw(
@@ -186,7 +195,8 @@ void eg_gltf_comp_draw(
     re_cmd_buffer_t *cmd_buffer,
     re_pipeline_t *pipeline,
     mat4_t transform) {
-  if (!model->asset) return;
+  // Nothing is drawn until the model has finished loading
+  if (!eg_asset_is_ready((eg_asset_t *)model->asset)) return;
 
   size_t offset = 0;
   re_cmd_bind_vertex_buffers(
@@ -205,7 +215,7 @@ void eg_gltf_comp_draw_no_mat(
     re_cmd_buffer_t *cmd_buffer,
     re_pipeline_t *pipeline,
     mat4_t transform) {
-  if (!model->asset) return;
+  if (!eg_asset_is_ready((eg_asset_t *)model->asset)) return;
 
   size_t offset = 0;
   re_cmd_bind_vertex_buffers(
@@ -32,6 +32,9 @@ void eg_gltf_comp_deserialize(
  */
 void eg_gltf_comp_init(eg_gltf_comp_t *model, eg_gltf_asset_t *asset);
 
+// Retains the model, see EG_COMP_RETAINERS
+void eg_gltf_comp_retain(eg_gltf_comp_t *model);
+
 void eg_gltf_comp_draw(
     eg_gltf_comp_t *model,
     re_cmd_buffer_t *cmd_buffer,
@@ -0,0 +1,70 @@
+#include "hierarchy_comp.h"
+
+#include "../deserializer.h"
+#include "../imgui.h"
+#include "../inspector.h"
+#include "../serializer.h"
+
+void eg_hierarchy_comp_default(eg_hierarchy_comp_t *hierarchy) {
+  hierarchy->parent = EG_NULL_ENTITY;
+  hierarchy->dirty  = true;
+}
+
+void eg_hierarchy_comp_inspect(
+    eg_hierarchy_comp_t *hierarchy, eg_inspector_t *inspector) {
+  eg_entity_manager_t *entity_manager = &inspector->scene->entity_manager;
+
+  int parent = -1;
+  if (eg_entity_exists(entity_manager, hierarchy->parent)) {
+    parent = (int)EG_ENTITY_INDEX(hierarchy->parent);
+  }
+
+  if (igInputInt("Parent", &parent, 1, 1, 0)) {
+    eg_entity_t new_parent = EG_NULL_ENTITY;
+    if (parent >= 0 && (uint32_t)parent < entity_manager->entity_max) {
+      new_parent = eg_entity_from_index(entity_manager, (uint32_t)parent);
+    }
+
+    eg_hierarchy_comp_set_parent(hierarchy, new_parent);
+  }
+}
+
+void eg_hierarchy_comp_destroy(eg_hierarchy_comp_t *hierarchy) {}
+
+enum {
+  PROP_PARENT,
+  PROP_MAX,
+};
+
+void eg_hierarchy_comp_serialize(
+    eg_hierarchy_comp_t *hierarchy, eg_serializer_t *serializer) {
+  eg_serializer_append_u32(serializer, PROP_MAX);
+
+  eg_serializer_append_u32(serializer, PROP_PARENT);
+  eg_serializer_append_entity(serializer, hierarchy->parent);
+}
+
+void eg_hierarchy_comp_deserialize(
+    eg_hierarchy_comp_t *hierarchy, eg_deserializer_t *deserializer) {
+  uint32_t prop_count = eg_deserializer_read_u32(deserializer);
+
+  for (uint32_t i = 0; i < prop_count; i++) {
+    uint32_t prop = eg_deserializer_read_u32(deserializer);
+
+    switch (prop) {
+    case PROP_PARENT: {
+      hierarchy->parent = eg_deserializer_read_entity(deserializer);
+      break;
+    }
+    default: break;
+    }
+  }
+
+  hierarchy->dirty = true;
+}
+
+void eg_hierarchy_comp_set_parent(
+    eg_hierarchy_comp_t *hierarchy, eg_entity_t parent) {
+  hierarchy->parent = parent;
+  hierarchy->dirty  = true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../entity_manager.h"
+#include <stdbool.h>
+
+typedef struct eg_inspector_t eg_inspector_t;
+typedef struct eg_serializer_t eg_serializer_t;
+typedef struct eg_deserializer_t eg_deserializer_t;
+
+/*
+ * Attaches an entity to a parent entity. The world matrix of the entity
+ * becomes the parent's world matrix times its own transform.
+ */
+typedef struct eg_hierarchy_comp_t {
+  eg_entity_t parent; // EG_NULL_ENTITY when detached
+
+  // Set when the parent changes, so the transform system re-sorts the
+  // hierarchy
+  bool dirty;
+} eg_hierarchy_comp_t;
+
+/*
+ * Required component functions
+ */
+void eg_hierarchy_comp_default(eg_hierarchy_comp_t *hierarchy);
+
+void eg_hierarchy_comp_inspect(
+    eg_hierarchy_comp_t *hierarchy, eg_inspector_t *inspector);
+
+void eg_hierarchy_comp_destroy(eg_hierarchy_comp_t *hierarchy);
+
+void eg_hierarchy_comp_serialize(
+    eg_hierarchy_comp_t *hierarchy, eg_serializer_t *serializer);
+
+void eg_hierarchy_comp_deserialize(
+    eg_hierarchy_comp_t *hierarchy, eg_deserializer_t *deserializer);
+
+/*
+ * Specific functions
+ */
+void eg_hierarchy_comp_set_parent(
+    eg_hierarchy_comp_t *hierarchy, eg_entity_t parent);
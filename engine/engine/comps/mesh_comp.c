@@ -26,7 +26,12 @@ void eg_mesh_comp_inspect(eg_mesh_comp_t *mesh, eg_inspector_t *inspector) {
       });
 }
 
-void eg_mesh_comp_destroy(eg_mesh_comp_t *mesh) {}
+void eg_mesh_comp_destroy(eg_mesh_comp_t *mesh) {
+  eg_asset_release((eg_asset_t *)mesh->material);
+  eg_asset_release((eg_asset_t *)mesh->asset);
+  mesh->material = NULL;
+  mesh->asset    = NULL;
+}
 
 enum {
   PROP_MATERIAL,
@@ -62,12 +67,14 @@ void eg_mesh_comp_deserialize(
       eg_asset_uid_t uid = eg_deserializer_read_u32(deserializer);
       mesh->material =
           eg_asset_manager_get_by_uid(deserializer->asset_manager, uid);
+      eg_asset_retain((eg_asset_t *)mesh->material);
       break;
     }
     case PROP_MESH: {
       eg_asset_uid_t uid = eg_deserializer_read_u32(deserializer);
       mesh->asset =
           eg_asset_manager_get_by_uid(deserializer->asset_manager, uid);
+      eg_asset_retain((eg_asset_t *)mesh->asset);
       break;
     }
     default: break;
@@ -81,6 +88,14 @@ void eg_mesh_comp_init(
     eg_pbr_material_asset_t *material) {
   mesh->asset    = asset;
   mesh->material = material;
+
+  eg_asset_retain((eg_asset_t *)asset);
+  eg_asset_retain((eg_asset_t *)material);
+}
+
+void eg_mesh_comp_retain(eg_mesh_comp_t *mesh) {
+  eg_asset_retain((eg_asset_t *)mesh->asset);
+  eg_asset_retain((eg_asset_t *)mesh->material);
 }
 
 void eg_mesh_comp_draw(
@@ -37,6 +37,9 @@ void eg_mesh_comp_init(
     eg_mesh_asset_t *asset,
     eg_pbr_material_asset_t *material);
 
+// Retains the mesh and material, see EG_COMP_RETAINERS
+void eg_mesh_comp_retain(eg_mesh_comp_t *mesh);
+
 void eg_mesh_comp_draw(
     eg_mesh_comp_t *mesh,
     re_cmd_buffer_t *cmd_buffer,
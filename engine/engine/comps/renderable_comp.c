@@ -23,6 +23,7 @@ void eg_renderable_comp_inspect(
 }
 
 void eg_renderable_comp_destroy(eg_renderable_comp_t *renderable) {
+  eg_asset_release((eg_asset_t *)renderable->pipeline);
   renderable->pipeline = NULL;
 }
 
@@ -54,6 +55,7 @@ void eg_renderable_comp_deserialize(
       eg_asset_uid_t uid = eg_deserializer_read_u32(deserializer);
       renderable->pipeline =
           eg_asset_manager_get_by_uid(deserializer->asset_manager, uid);
+      eg_asset_retain((eg_asset_t *)renderable->pipeline);
       break;
     }
     default: break;
@@ -64,6 +66,11 @@ void eg_renderable_comp_deserialize(
 void eg_renderable_comp_init(
     eg_renderable_comp_t *renderable, eg_pipeline_asset_t *pipeline) {
   renderable->pipeline = pipeline;
+  eg_asset_retain((eg_asset_t *)pipeline);
+}
+
+void eg_renderable_comp_retain(eg_renderable_comp_t *renderable) {
+  eg_asset_retain((eg_asset_t *)renderable->pipeline);
 }
 
 re_pipeline_t *
@@ -34,5 +34,8 @@ void eg_renderable_comp_deserialize(
 void eg_renderable_comp_init(
     eg_renderable_comp_t *renderable, eg_pipeline_asset_t *pipeline);
 
+// Retains the pipeline, see EG_COMP_RETAINERS
+void eg_renderable_comp_retain(eg_renderable_comp_t *renderable);
+
 re_pipeline_t *
 eg_renderable_comp_get_pipeline(eg_renderable_comp_t *renderable);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <gmath.h>
+#include <stdbool.h>
 
 typedef struct eg_inspector_t eg_inspector_t;
 typedef struct eg_serializer_t eg_serializer_t;
@@ -11,6 +12,10 @@ typedef struct eg_transform_comp_t {
   vec3_t axis;
   float angle;
   vec3_t scale;
+
+  // Must be set after changing the transform, so that the transform system
+  // rebuilds its world matrix
+  bool dirty;
 } eg_transform_comp_t;
 
 /*
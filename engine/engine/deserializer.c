@@ -63,13 +63,22 @@ void eg_deserialize_scene(
 
   eg_scene_deserialize(scene, deserializer);
 
+  // Add all entities up front, so components can reference entities that
+  // come later in the file
+  deserializer->entities     = malloc(entity_count * sizeof(eg_entity_t));
+  deserializer->entity_count = entity_count;
+
   for (uint32_t i = 0; i < entity_count; i++) {
-    eg_entity_t entity = eg_entity_add(entity_manager);
+    deserializer->entities[i] = eg_entity_add(entity_manager);
+  }
+
+  for (uint32_t i = 0; i < entity_count; i++) {
+    eg_entity_t entity = deserializer->entities[i];
 
     uint64_t tags       = eg_deserializer_read_u64(deserializer);
     uint32_t comp_count = eg_deserializer_read_u32(deserializer);
 
-    entity_manager->tags[entity] = tags;
+    eg_entity_set_tags(entity_manager, entity, tags);
 
     for (uint32_t j = 0; j < comp_count; j++) {
       eg_comp_type_t comp_type = eg_deserializer_read_u32(deserializer);
@@ -79,6 +88,10 @@ void eg_deserialize_scene(
     }
   }
 
+  free(deserializer->entities);
+  deserializer->entities     = NULL;
+  deserializer->entity_count = 0;
+
   deserializer->asset_manager  = NULL;
   deserializer->entity_manager = NULL;
 
@@ -114,3 +127,12 @@ uint64_t eg_deserializer_read_u64(eg_deserializer_t *deserializer) {
   eg_deserializer_read(deserializer, &value, sizeof(value));
   return value;
 }
+
+eg_entity_t eg_deserializer_read_entity(eg_deserializer_t *deserializer) {
+  uint32_t id = eg_deserializer_read_u32(deserializer);
+  if (id >= deserializer->entity_count) {
+    return EG_NULL_ENTITY;
+  }
+
+  return deserializer->entities[id];
+}
@@ -2,9 +2,9 @@
 
 #include "assets/asset_types.h"
 #include "comps/comp_types.h"
+#include "entity_manager.h"
 
 typedef struct eg_scene_t eg_scene_t;
-typedef struct eg_entity_manager_t eg_entity_manager_t;
 typedef struct eg_asset_manager_t eg_asset_manager_t;
 
 typedef struct eg_deserializer_t {
@@ -14,6 +14,10 @@ typedef struct eg_deserializer_t {
 
   eg_entity_manager_t *entity_manager;
   eg_asset_manager_t *asset_manager;
+
+  // Entities of the scene being deserialized, in the order they were written
+  eg_entity_t *entities;
+  uint32_t entity_count;
 } eg_deserializer_t;
 
 void eg_deserializer_init(eg_deserializer_t *deserializer);
@@ -36,3 +40,6 @@ char *eg_deserializer_read_string(eg_deserializer_t *deserializer);
 uint32_t eg_deserializer_read_u32(eg_deserializer_t *deserializer);
 
 uint64_t eg_deserializer_read_u64(eg_deserializer_t *deserializer);
+
+// Reads a reference written by eg_serializer_append_entity
+eg_entity_t eg_deserializer_read_entity(eg_deserializer_t *deserializer);
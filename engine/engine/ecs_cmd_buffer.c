@@ -0,0 +1,341 @@
+#include "ecs_cmd_buffer.h"
+
+#include "comps/hierarchy_comp.h"
+#include "comps/transform_comp.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_STREAM_CAP 4096
+
+/*
+ * Placeholder handles use the all-ones generation, which is never given to
+ * real entities. Their index is the recording stream in the top bits and the
+ * placeholder number in the rest, so a placeholder passed to another thread
+ * can be caught when it's resolved.
+ */
+#define PLACEHOLDER_STREAM_BITS 6
+#define PLACEHOLDER_NUMBER_BITS (EG_ENTITY_INDEX_BITS - PLACEHOLDER_STREAM_BITS)
+#define PLACEHOLDER_NUMBER_MASK ((1U << PLACEHOLDER_NUMBER_BITS) - 1)
+
+_Static_assert(
+    EG_MAX_THREADS <= (1U << PLACEHOLDER_STREAM_BITS),
+    "every stream must fit in a placeholder");
+
+#define PLACEHOLDER(stream, n)                                                 \
+  ((EG_ENTITY_GENERATION_MASK << EG_ENTITY_INDEX_BITS) |                       \
+   ((stream) << PLACEHOLDER_NUMBER_BITS) | (n))
+
+#define PLACEHOLDER_STREAM(entity)                                             \
+  (EG_ENTITY_INDEX(entity) >> PLACEHOLDER_NUMBER_BITS)
+#define PLACEHOLDER_NUMBER(entity) ((entity)&PLACEHOLDER_NUMBER_MASK)
+
+#define IS_PLACEHOLDER(entity)                                                 \
+  ((entity) != EG_NULL_ENTITY &&                                               \
+   EG_ENTITY_GENERATION(entity) == EG_ENTITY_GENERATION_MASK)
+
+// Payloads are padded so the next header stays aligned
+#define PAYLOAD_SIZE(size) (((size) + 7) & ~(size_t)7)
+
+typedef struct cmd_header_t {
+  uint32_t type;
+  eg_entity_t entity;
+  uint32_t comp;
+  uint32_t payload_size;
+} cmd_header_t;
+
+static inline eg_ecs_cmd_stream_t *
+current_stream(eg_ecs_cmd_buffer_t *cmd_buffer) {
+  assert(eg_worker_id < EG_MAX_THREADS);
+
+#ifndef NDEBUG
+  if (eg_worker_id == 0) {
+    assert(
+        thrd_equal(thrd_current(), cmd_buffer->owner) &&
+        "only the thread that initialized the buffer can record without "
+        "being a worker");
+  } else {
+    eg_task_scheduler_t *expected  = NULL;
+    eg_task_scheduler_t *scheduler = eg_current_scheduler();
+    if (!atomic_compare_exchange_strong_explicit(
+            &cmd_buffer->scheduler,
+            &expected,
+            scheduler,
+            memory_order_relaxed,
+            memory_order_relaxed)) {
+      assert(
+          expected == scheduler &&
+          "workers of another scheduler share the streams' ids");
+    }
+  }
+#endif
+
+  return &cmd_buffer->streams[eg_worker_id];
+}
+
+// Returns the command's copy of the payload
+static void *push_cmd(
+    eg_ecs_cmd_stream_t *stream,
+    eg_ecs_cmd_type_t type,
+    eg_entity_t entity,
+    uint32_t comp,
+    const void *payload,
+    uint32_t payload_size) {
+  size_t cmd_size = sizeof(cmd_header_t) + PAYLOAD_SIZE(payload_size);
+
+  if (stream->size + cmd_size > stream->cap) {
+    size_t new_cap = stream->cap == 0 ? INITIAL_STREAM_CAP : stream->cap;
+    while (new_cap < stream->size + cmd_size) {
+      new_cap *= 2;
+    }
+
+    stream->data = realloc(stream->data, new_cap);
+    stream->cap  = new_cap;
+  }
+
+  cmd_header_t *header = (cmd_header_t *)&stream->data[stream->size];
+  header->type         = (uint32_t)type;
+  header->entity       = entity;
+  header->comp         = comp;
+  header->payload_size = payload_size;
+
+  if (payload_size > 0) {
+    memcpy(header + 1, payload, payload_size);
+  }
+
+  stream->size += cmd_size;
+
+  return header + 1;
+}
+
+// Releases the assets held by the payload of a set command that never reaches
+// its component
+static inline void drop_set_payload(uint32_t comp, void *payload) {
+  if (EG_COMP_RETAINERS[comp] != NULL) {
+    EG_COMP_DESTRUCTORS[comp](payload);
+  }
+}
+
+void eg_ecs_cmd_buffer_init(eg_ecs_cmd_buffer_t *cmd_buffer) {
+  memset(cmd_buffer, 0, sizeof(*cmd_buffer));
+  cmd_buffer->owner = thrd_current();
+  atomic_init(&cmd_buffer->scheduler, NULL);
+}
+
+void eg_ecs_cmd_buffer_destroy(eg_ecs_cmd_buffer_t *cmd_buffer) {
+  for (uint32_t i = 0; i < EG_MAX_THREADS; i++) {
+    eg_ecs_cmd_stream_t *stream = &cmd_buffer->streams[i];
+
+    size_t offset = 0;
+    while (offset < stream->size) {
+      cmd_header_t *header = (cmd_header_t *)&stream->data[offset];
+      offset += sizeof(cmd_header_t) + PAYLOAD_SIZE(header->payload_size);
+
+      if (header->type == EG_ECS_CMD_SET_COMP) {
+        drop_set_payload(header->comp, header + 1);
+      }
+    }
+
+    free(stream->data);
+  }
+
+  free(cmd_buffer->created);
+}
+
+static inline eg_entity_t resolve(
+    eg_ecs_cmd_buffer_t *cmd_buffer,
+    uint32_t stream_id,
+    uint32_t created_count,
+    eg_entity_t entity) {
+  if (!IS_PLACEHOLDER(entity)) return entity;
+
+  // A placeholder from another stream would stand for an unrelated entity
+  assert(
+      PLACEHOLDER_STREAM(entity) == stream_id &&
+      "placeholder recorded by another thread");
+  if (PLACEHOLDER_STREAM(entity) != stream_id) return EG_NULL_ENTITY;
+
+  uint32_t n = PLACEHOLDER_NUMBER(entity);
+  if (n >= created_count) return EG_NULL_ENTITY;
+
+  return cmd_buffer->created[n];
+}
+
+static void flush_stream(
+    eg_ecs_cmd_buffer_t *cmd_buffer,
+    uint32_t stream_id,
+    eg_entity_manager_t *entity_manager) {
+  eg_ecs_cmd_stream_t *stream = &cmd_buffer->streams[stream_id];
+  uint32_t created_count      = 0;
+
+  size_t offset = 0;
+  while (offset < stream->size) {
+    cmd_header_t *header = (cmd_header_t *)&stream->data[offset];
+    void *payload        = header + 1;
+
+    offset += sizeof(cmd_header_t) + PAYLOAD_SIZE(header->payload_size);
+
+    if (header->type == EG_ECS_CMD_ADD_ENTITY) {
+      cmd_buffer->created[created_count++] = eg_entity_add(entity_manager);
+      continue;
+    }
+
+    eg_entity_t entity =
+        resolve(cmd_buffer, stream_id, created_count, header->entity);
+    if (!eg_entity_exists(entity_manager, entity)) {
+      if (header->type == EG_ECS_CMD_SET_COMP) {
+        drop_set_payload(header->comp, payload);
+      }
+      continue;
+    }
+
+    eg_comp_type_t comp = (eg_comp_type_t)header->comp;
+
+    switch ((eg_ecs_cmd_type_t)header->type) {
+    case EG_ECS_CMD_REMOVE_ENTITY: {
+      eg_entity_remove(entity_manager, entity);
+      break;
+    }
+    case EG_ECS_CMD_ADD_COMP: {
+      eg_comp_add(entity_manager, entity, comp);
+      break;
+    }
+    case EG_ECS_CMD_REMOVE_COMP: {
+      eg_comp_remove(entity_manager, entity, comp);
+      break;
+    }
+    case EG_ECS_CMD_SET_COMP: {
+      void *comp_ptr;
+      if (EG_HAS_COMP_ID(entity_manager, entity, comp)) {
+        comp_ptr = EG_COMP_BY_ID(entity_manager, entity, comp);
+      } else {
+        comp_ptr = eg_comp_add(entity_manager, entity, comp);
+      }
+
+      // The payload's asset references move to the component
+      EG_COMP_DESTRUCTORS[comp](comp_ptr);
+      memcpy(comp_ptr, payload, EG_COMP_SIZES[comp]);
+
+      // The transform system only picks up the components marked as changed
+      if (comp == EG_COMP_TYPE(eg_transform_comp_t)) {
+        ((eg_transform_comp_t *)comp_ptr)->dirty = true;
+      } else if (comp == EG_COMP_TYPE(eg_hierarchy_comp_t)) {
+        ((eg_hierarchy_comp_t *)comp_ptr)->dirty = true;
+      }
+      break;
+    }
+    case EG_ECS_CMD_SET_TAGS: {
+      eg_entity_tag_t tags;
+      memcpy(&tags, payload, sizeof(tags));
+      eg_entity_set_tags(entity_manager, entity, tags);
+      break;
+    }
+    default: break;
+    }
+  }
+
+  stream->size         = 0;
+  stream->entity_count = 0;
+}
+
+void eg_ecs_cmd_buffer_flush(
+    eg_ecs_cmd_buffer_t *cmd_buffer, eg_entity_manager_t *entity_manager) {
+  uint32_t add_count     = 0;
+  uint32_t max_add_count = 0;
+
+  for (uint32_t i = 0; i < EG_MAX_THREADS; i++) {
+    uint32_t count = cmd_buffer->streams[i].entity_count;
+
+    add_count += count;
+    if (count > max_add_count) max_add_count = count;
+  }
+
+  // Grow the pools once for all the added entities, instead of while adding
+  // them one by one
+  uint64_t needed = (uint64_t)entity_manager->entity_max + add_count;
+  if (needed > EG_MAX_ENTITIES) needed = EG_MAX_ENTITIES;
+  eg_entity_manager_reserve(entity_manager, (uint32_t)needed);
+
+  if (max_add_count > cmd_buffer->created_cap) {
+    cmd_buffer->created_cap = max_add_count;
+    cmd_buffer->created     = realloc(
+        cmd_buffer->created,
+        cmd_buffer->created_cap * sizeof(*cmd_buffer->created));
+  }
+
+  for (uint32_t i = 0; i < EG_MAX_THREADS; i++) {
+    if (cmd_buffer->streams[i].size > 0) {
+      flush_stream(cmd_buffer, i, entity_manager);
+    }
+  }
+}
+
+eg_entity_t eg_ecs_cmd_add_entity(eg_ecs_cmd_buffer_t *cmd_buffer) {
+  eg_ecs_cmd_stream_t *stream = current_stream(cmd_buffer);
+
+  // Keep clear of EG_NULL_ENTITY and the values right below it
+  assert(stream->entity_count < PLACEHOLDER_NUMBER_MASK - 3);
+
+  eg_entity_t placeholder =
+      PLACEHOLDER(eg_worker_id, stream->entity_count++);
+  push_cmd(stream, EG_ECS_CMD_ADD_ENTITY, placeholder, 0, NULL, 0);
+
+  return placeholder;
+}
+
+void eg_ecs_cmd_remove_entity(
+    eg_ecs_cmd_buffer_t *cmd_buffer, eg_entity_t entity) {
+  push_cmd(
+      current_stream(cmd_buffer),
+      EG_ECS_CMD_REMOVE_ENTITY,
+      entity,
+      0,
+      NULL,
+      0);
+}
+
+void eg_ecs_cmd_add_comp(
+    eg_ecs_cmd_buffer_t *cmd_buffer, eg_entity_t entity, eg_comp_type_t comp) {
+  push_cmd(
+      current_stream(cmd_buffer), EG_ECS_CMD_ADD_COMP, entity, comp, NULL, 0);
+}
+
+void eg_ecs_cmd_remove_comp(
+    eg_ecs_cmd_buffer_t *cmd_buffer, eg_entity_t entity, eg_comp_type_t comp) {
+  push_cmd(
+      current_stream(cmd_buffer),
+      EG_ECS_CMD_REMOVE_COMP,
+      entity,
+      comp,
+      NULL,
+      0);
+}
+
+void eg_ecs_cmd_set_comp(
+    eg_ecs_cmd_buffer_t *cmd_buffer,
+    eg_entity_t entity,
+    eg_comp_type_t comp,
+    const void *data) {
+  void *payload = push_cmd(
+      current_stream(cmd_buffer),
+      EG_ECS_CMD_SET_COMP,
+      entity,
+      comp,
+      data,
+      (uint32_t)EG_COMP_SIZES[comp]);
+
+  if (EG_COMP_RETAINERS[comp] != NULL) {
+    EG_COMP_RETAINERS[comp](payload);
+  }
+}
+
+void eg_ecs_cmd_set_tags(
+    eg_ecs_cmd_buffer_t *cmd_buffer, eg_entity_t entity, eg_entity_tag_t tags) {
+  push_cmd(
+      current_stream(cmd_buffer),
+      EG_ECS_CMD_SET_TAGS,
+      entity,
+      0,
+      &tags,
+      sizeof(tags));
+}
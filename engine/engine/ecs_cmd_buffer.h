@@ -0,0 +1,103 @@
+#pragma once
+
+#include "entity_manager.h"
+#include "task_scheduler.h"
+#include <stddef.h>
+
+/*
+ * Records structural changes to the entity manager (adding and removing
+ * entities and components, setting components and tags) so that they can be
+ * made from inside system loops and from several threads at once. Each thread
+ * records into its own stream (picked with eg_worker_id), so recording
+ * doesn't need any locks. The commands are applied with
+ * eg_ecs_cmd_buffer_flush at a sync point, when no system is running.
+ *
+ * Only the thread that initialized the buffer and the workers of a single
+ * scheduler can record into it: every other thread has the same eg_worker_id
+ * as the first one, and would share its stream.
+ *
+ * eg_ecs_cmd_add_entity returns a placeholder handle that is only valid in
+ * commands recorded by the same thread into the same buffer. It gets replaced
+ * with the real entity when the buffer is flushed. Each thread can add up to
+ * 65532 entities between flushes.
+ */
+
+typedef enum eg_ecs_cmd_type_t {
+  EG_ECS_CMD_ADD_ENTITY,
+  EG_ECS_CMD_REMOVE_ENTITY,
+  EG_ECS_CMD_ADD_COMP,
+  EG_ECS_CMD_REMOVE_COMP,
+  EG_ECS_CMD_SET_COMP,
+  EG_ECS_CMD_SET_TAGS,
+} eg_ecs_cmd_type_t;
+
+typedef struct eg_ecs_cmd_stream_t {
+  // Packed commands, each one followed by its payload
+  uint8_t *data;
+  size_t size;
+  size_t cap;
+
+  uint32_t entity_count; // Placeholder entities added by this stream
+} eg_ecs_cmd_stream_t;
+
+typedef struct eg_ecs_cmd_buffer_t {
+  eg_ecs_cmd_stream_t streams[EG_MAX_THREADS];
+
+  // Placeholder -> real entity, used during the flush
+  eg_entity_t *created;
+  uint32_t created_cap;
+
+  // The threads allowed to record, see above. The scheduler is the one of the
+  // first worker that records.
+  thrd_t owner;
+  _Atomic(eg_task_scheduler_t *) scheduler;
+} eg_ecs_cmd_buffer_t;
+
+void eg_ecs_cmd_buffer_init(eg_ecs_cmd_buffer_t *cmd_buffer);
+
+// Commands that were never flushed are dropped
+void eg_ecs_cmd_buffer_destroy(eg_ecs_cmd_buffer_t *cmd_buffer);
+
+// Applies the recorded commands (thread by thread, in recording order) and
+// clears the buffer. Commands on entities that no longer exist are skipped.
+void eg_ecs_cmd_buffer_flush(
+    eg_ecs_cmd_buffer_t *cmd_buffer, eg_entity_manager_t *entity_manager);
+
+eg_entity_t eg_ecs_cmd_add_entity(eg_ecs_cmd_buffer_t *cmd_buffer);
+
+void eg_ecs_cmd_remove_entity(
+    eg_ecs_cmd_buffer_t *cmd_buffer, eg_entity_t entity);
+
+void eg_ecs_cmd_add_comp(
+    eg_ecs_cmd_buffer_t *cmd_buffer, eg_entity_t entity, eg_comp_type_t comp);
+
+void eg_ecs_cmd_remove_comp(
+    eg_ecs_cmd_buffer_t *cmd_buffer, eg_entity_t entity, eg_comp_type_t comp);
+
+// Replaces the value of a component with a copy of `data` (EG_COMP_SIZES[comp]
+// bytes), adding the component if the entity doesn't have it. The old value
+// gets destroyed. Transform and hierarchy components are marked as dirty.
+//
+// The copy retains the assets it points to (see EG_COMP_RETAINERS), so the
+// caller keeps its own references. They go to the component on flush, or get
+// released if the entity is gone by then or the buffer is destroyed first.
+void eg_ecs_cmd_set_comp(
+    eg_ecs_cmd_buffer_t *cmd_buffer,
+    eg_entity_t entity,
+    eg_comp_type_t comp,
+    const void *data);
+
+void eg_ecs_cmd_set_tags(
+    eg_ecs_cmd_buffer_t *cmd_buffer, eg_entity_t entity, eg_entity_tag_t tags);
+
+#define EG_CMD_ADD_COMP(cmd_buffer, entity, comp)                              \
+  eg_ecs_cmd_add_comp(cmd_buffer, entity, EG_COMP_TYPE(comp))
+
+#define EG_CMD_REMOVE_COMP(cmd_buffer, entity, comp)                           \
+  eg_ecs_cmd_remove_comp(cmd_buffer, entity, EG_COMP_TYPE(comp))
+
+#define EG_CMD_SET_COMP(cmd_buffer, entity, comp, value)                       \
+  do {                                                                         \
+    comp _eg_value = (value);                                                  \
+    eg_ecs_cmd_set_comp(cmd_buffer, entity, EG_COMP_TYPE(comp), &_eg_value);   \
+  } while (0)
@@ -40,9 +40,33 @@ void eg_engine_init() {
       1,
       0,
       0);
+
+  re_image_init(
+      &g_eng.black_cubemap,
+      &(re_image_options_t){
+          .width       = 1,
+          .height      = 1,
+          .layer_count = 6,
+          .format      = VK_FORMAT_R8G8B8A8_UNORM,
+          .usage       = RE_IMAGE_USAGE_SAMPLED | RE_IMAGE_USAGE_TRANSFER_DST,
+      });
+
+  for (uint32_t face = 0; face < 6; face++) {
+    re_image_upload(
+        &g_eng.black_cubemap,
+        g_ctx.transient_command_pool,
+        (uint8_t[]){0, 0, 0, 255},
+        1,
+        1,
+        0,
+        face);
+  }
 }
 
 void eg_engine_destroy() {
+  VK_CHECK(vkDeviceWaitIdle(g_ctx.device));
+
   re_image_destroy(&g_eng.white_texture);
   re_image_destroy(&g_eng.black_texture);
+  re_image_destroy(&g_eng.black_cubemap);
 }
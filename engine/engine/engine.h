@@ -5,6 +5,7 @@
 typedef struct eg_engine_t {
   re_image_t white_texture;
   re_image_t black_texture;
+  re_image_t black_cubemap; // Stands in for environment maps still loading
 } eg_engine_t;
 
 extern eg_engine_t g_eng;
@@ -1,17 +1,88 @@
 #include "entity_manager.h"
 
 #include "util.h"
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define INITIAL_ENTITY_CAP EG_ENTITY_CHUNK_SIZE
+
+_Static_assert(EG_COMP_TYPE_MAX <= 64, "component masks must fit in 64 bits");
+_Static_assert(EG_TAG_MAX <= 64, "tag masks must fit in 64 bits");
+
+static uint64_t *
+grow_bitset(uint64_t *bitset, uint32_t old_cap, uint32_t new_cap) {
+  uint32_t old_words = EG_BITSET_WORDS(old_cap);
+  uint32_t new_words = EG_BITSET_WORDS(new_cap);
+
+  bitset = realloc(bitset, new_words * sizeof(*bitset));
+  memset(&bitset[old_words], 0, (new_words - old_words) * sizeof(*bitset));
+
+  return bitset;
+}
+
+static void add_chunks(eg_comp_pool_t *pool, uint32_t comp, uint32_t count) {
+  // Only the chunk table gets reallocated, the chunks stay where they are
+  pool->chunks = realloc(
+      pool->chunks, (pool->chunk_count + count) * sizeof(*pool->chunks));
+
+  for (uint32_t i = pool->chunk_count; i < pool->chunk_count + count; i++) {
+    pool->chunks[i] = calloc(EG_ENTITY_CHUNK_SIZE, EG_COMP_SIZES[comp]);
+  }
+
+  pool->chunk_count += count;
+}
+
+static void grow(eg_entity_manager_t *entity_manager, uint32_t new_cap) {
+  uint32_t old_cap = entity_manager->entity_cap;
+
+  for (uint32_t c = 0; c < EG_COMP_TYPE_MAX; c++) {
+    eg_comp_pool_t *pool = &entity_manager->pools[c];
+
+    if (EG_COMP_STORAGES[c] == EG_COMP_STORAGE_DENSE) {
+      add_chunks(pool, c, (new_cap - old_cap) / EG_ENTITY_CHUNK_SIZE);
+    } else {
+      // The dense array grows with the component count, only the entity map
+      // grows with the entities
+      pool->sparse = realloc(pool->sparse, new_cap * sizeof(*pool->sparse));
+      for (uint32_t i = old_cap; i < new_cap; i++) {
+        pool->sparse[i] = UINT32_MAX;
+      }
+    }
+
+    entity_manager->comp_masks[c] =
+        grow_bitset(entity_manager->comp_masks[c], old_cap, new_cap);
+  }
+
+  for (uint32_t t = 0; t < EG_TAG_MAX; t++) {
+    entity_manager->tag_masks[t] =
+        grow_bitset(entity_manager->tag_masks[t], old_cap, new_cap);
+  }
+
+  entity_manager->existence =
+      grow_bitset(entity_manager->existence, old_cap, new_cap);
+
+  entity_manager->generations = realloc(
+      entity_manager->generations,
+      new_cap * sizeof(*entity_manager->generations));
+  memset(
+      &entity_manager->generations[old_cap],
+      0,
+      (new_cap - old_cap) * sizeof(*entity_manager->generations));
+
+  // There can't be more free indices than slots
+  entity_manager->free_indices = realloc(
+      entity_manager->free_indices,
+      new_cap * sizeof(*entity_manager->free_indices));
+
+  entity_manager->entity_cap = new_cap;
+}
+
 void eg_entity_manager_init(eg_entity_manager_t *entity_manager) {
   memset(entity_manager, 0, sizeof(*entity_manager));
 
   // Initialize component pools
-  for (uint32_t comp = 0; comp < EG_COMP_TYPE_MAX; comp++) {
-    entity_manager->pools[comp].data =
-        calloc(EG_MAX_ENTITIES, EG_COMP_SIZES[comp]);
-  }
+  grow(entity_manager, INITIAL_ENTITY_CAP);
 }
 
 void eg_entity_manager_destroy(eg_entity_manager_t *entity_manager) {
@@ -22,22 +93,59 @@ void eg_entity_manager_destroy(eg_entity_manager_t *entity_manager) {
   }
 
   for (uint32_t c = 0; c < EG_COMP_TYPE_MAX; c++) {
-    free(entity_manager->pools[c].data);
+    eg_comp_pool_t *pool = &entity_manager->pools[c];
+
+    for (uint32_t i = 0; i < pool->chunk_count; i++) {
+      free(pool->chunks[i]);
+    }
+    free(pool->chunks);
+    free(pool->sparse);
+    free(pool->dense_indices);
+    free(entity_manager->comp_masks[c]);
   }
+
+  for (uint32_t t = 0; t < EG_TAG_MAX; t++) {
+    free(entity_manager->tag_masks[t]);
+  }
+
+  free(entity_manager->existence);
+  free(entity_manager->generations);
+  free(entity_manager->free_indices);
+}
+
+void eg_entity_manager_reserve(
+    eg_entity_manager_t *entity_manager, uint32_t count) {
+  if (count <= entity_manager->entity_cap) {
+    return;
+  }
+
+  assert(count <= EG_MAX_ENTITIES);
+
+  uint32_t new_cap = entity_manager->entity_cap;
+  while (new_cap < count) {
+    new_cap *= 2;
+  }
+
+  grow(entity_manager, new_cap);
 }
 
 eg_entity_t eg_entity_add(eg_entity_manager_t *entity_manager) {
-  for (uint32_t e = 0; e < EG_MAX_ENTITIES; e++) {
-    if (!eg_entity_exists(entity_manager, e)) {
-      entity_manager->existence[e] = true;
-      if (entity_manager->entity_max <= e) {
-        entity_manager->entity_max = e + 1;
-      }
-      return e;
+  uint32_t index;
+
+  if (entity_manager->free_count > 0) {
+    index = entity_manager->free_indices[--entity_manager->free_count];
+  } else {
+    if (entity_manager->entity_max == EG_MAX_ENTITIES) {
+      return EG_NULL_ENTITY;
     }
+
+    index = entity_manager->entity_max++;
+    eg_entity_manager_reserve(entity_manager, entity_manager->entity_max);
   }
 
-  return UINT32_MAX;
+  EG_BITSET_SET(entity_manager->existence, index);
+
+  return eg_entity_from_index(entity_manager, index);
 }
 
 void eg_entity_remove(eg_entity_manager_t *entity_manager, eg_entity_t entity) {
@@ -45,45 +153,147 @@ void eg_entity_remove(eg_entity_manager_t *entity_manager, eg_entity_t entity) {
     return;
   }
 
-  entity_manager->existence[entity] = false;
+  uint32_t index = EG_ENTITY_INDEX(entity);
 
-  if (entity_manager->entity_max == entity + 1) {
-    uint32_t new_max = 0;
-    // @TODO: this is pretty expensive
-    for (eg_entity_t e = 0; e < entity_manager->entity_max; e++) {
-      if (eg_entity_exists(entity_manager, e)) {
-        new_max = e + 1;
-      }
-    }
-    entity_manager->entity_max = new_max;
+  for (uint32_t c = 0; c < EG_COMP_TYPE_MAX; c++) {
+    eg_comp_remove(entity_manager, entity, (eg_comp_type_t)c);
   }
 
-  for (uint32_t c = 0; c < EG_COMP_TYPE_MAX; c++) {
-    entity_manager->comp_masks[c][entity] = false;
+  EG_BITSET_CLEAR(entity_manager->existence, index);
+  eg_entity_set_tags(entity_manager, entity, 0);
 
-    if (EG_HAS_COMP_ID(entity_manager, entity, c)) {
-      EG_COMP_DESTRUCTORS[c](
-          &entity_manager->pools[c].data[entity * EG_COMP_SIZES[c]]);
-    }
+  // Invalidate existing handles to this slot
+  uint16_t generation =
+      (entity_manager->generations[index] + 1) & EG_ENTITY_GENERATION_MASK;
+  entity_manager->generations[index] = generation;
+
+  // Wrapping around would make the oldest handles valid again, so once the
+  // generation saturates the slot is retired instead of reused
+  if (generation == EG_ENTITY_GENERATION_MASK) {
+    return;
   }
+
+  entity_manager->free_indices[entity_manager->free_count++] = index;
 }
 
 bool eg_entity_exists(eg_entity_manager_t *entity_manager, eg_entity_t entity) {
-  if (entity >= EG_MAX_ENTITIES) {
+  uint32_t index = EG_ENTITY_INDEX(entity);
+  if (index >= entity_manager->entity_max) {
     return false;
   }
 
-  return entity_manager->existence[entity];
+  return EG_BITSET_AT(entity_manager->existence, index) &&
+         entity_manager->generations[index] == EG_ENTITY_GENERATION(entity);
+}
+
+eg_entity_tag_t
+eg_entity_get_tags(eg_entity_manager_t *entity_manager, eg_entity_t entity) {
+  eg_entity_tag_t tags = 0;
+
+  for (uint32_t t = 0; t < EG_TAG_MAX; t++) {
+    if (EG_HAS_TAG(entity_manager, entity, t)) {
+      tags |= EG_TAG_BIT(t);
+    }
+  }
+
+  return tags;
+}
+
+void eg_entity_set_tags(
+    eg_entity_manager_t *entity_manager,
+    eg_entity_t entity,
+    eg_entity_tag_t tags) {
+  for (uint32_t t = 0; t < EG_TAG_MAX; t++) {
+    EG_SET_TAG(entity_manager, entity, t, (tags & EG_TAG_BIT(t)) != 0);
+  }
+}
+
+// Returns the bits of the entities matching `query` in the given bitset word
+static inline uint64_t query_word(
+    eg_entity_manager_t *entity_manager,
+    const eg_query_t *query,
+    uint32_t word) {
+  uint64_t bits = entity_manager->existence[word];
+
+  for (uint64_t mask = query->all_comps; mask != 0 && bits != 0;
+       mask &= mask - 1) {
+    bits &= entity_manager->comp_masks[eg_ctz64(mask)][word];
+  }
+
+  for (uint64_t mask = query->none_comps; mask != 0 && bits != 0;
+       mask &= mask - 1) {
+    bits &= ~entity_manager->comp_masks[eg_ctz64(mask)][word];
+  }
+
+  for (uint64_t mask = query->all_tags; mask != 0 && bits != 0;
+       mask &= mask - 1) {
+    bits &= entity_manager->tag_masks[eg_ctz64(mask)][word];
+  }
+
+  for (uint64_t mask = query->none_tags; mask != 0 && bits != 0;
+       mask &= mask - 1) {
+    bits &= ~entity_manager->tag_masks[eg_ctz64(mask)][word];
+  }
+
+  return bits;
+}
+
+eg_query_iter_t
+eg_query_iter(eg_entity_manager_t *entity_manager, const eg_query_t *query) {
+  return (eg_query_iter_t){
+      .entity_manager = entity_manager,
+      .query          = *query,
+      .word           = 0,
+      .word_end       = EG_BITSET_WORDS(entity_manager->entity_max),
+      .matches        = 0,
+  };
+}
+
+bool eg_query_next(eg_query_iter_t *iter, eg_entity_t *entity) {
+  while (iter->matches == 0) {
+    if (iter->word >= iter->word_end) {
+      return false;
+    }
+
+    iter->matches =
+        query_word(iter->entity_manager, &iter->query, iter->word++);
+  }
+
+  uint32_t index = (iter->word - 1) * 64 + eg_ctz64(iter->matches);
+  iter->matches &= iter->matches - 1;
+
+  *entity = eg_entity_from_index(iter->entity_manager, index);
+
+  return true;
 }
 
 void *eg_comp_add(
     eg_entity_manager_t *entity_manager,
     eg_entity_t entity,
     eg_comp_type_t comp) {
-  entity_manager->comp_masks[comp][entity] = true;
+  assert(eg_entity_exists(entity_manager, entity));
 
-  void *comp_ptr =
-      &entity_manager->pools[comp].data[entity * EG_COMP_SIZES[comp]];
+  uint32_t index = EG_ENTITY_INDEX(entity);
+
+  if (EG_COMP_STORAGES[comp] == EG_COMP_STORAGE_SPARSE &&
+      !EG_HAS_COMP_ID(entity_manager, entity, comp)) {
+    eg_comp_pool_t *pool = &entity_manager->pools[comp];
+
+    if (pool->dense_count == pool->chunk_count * EG_ENTITY_CHUNK_SIZE) {
+      add_chunks(pool, comp, 1);
+      pool->dense_indices = realloc(
+          pool->dense_indices,
+          pool->chunk_count * EG_ENTITY_CHUNK_SIZE *
+              sizeof(*pool->dense_indices));
+    }
+
+    pool->sparse[index]                      = pool->dense_count;
+    pool->dense_indices[pool->dense_count++] = index;
+  }
+
+  EG_BITSET_SET(entity_manager->comp_masks[comp], index);
+
+  void *comp_ptr = EG_COMP_BY_ID(entity_manager, entity, comp);
   EG_COMP_INITIALIZERS[comp](comp_ptr);
 
   return comp_ptr;
@@ -93,9 +303,31 @@ void eg_comp_remove(
     eg_entity_manager_t *entity_manager,
     eg_entity_t entity,
     eg_comp_type_t comp) {
-  if (EG_HAS_COMP_ID(entity_manager, entity, comp)) {
-    EG_COMP_DESTRUCTORS[comp](EG_COMP_BY_ID(entity_manager, entity, comp));
+  if (!EG_HAS_COMP_ID(entity_manager, entity, comp)) {
+    return;
+  }
+
+  EG_COMP_DESTRUCTORS[comp](EG_COMP_BY_ID(entity_manager, entity, comp));
+
+  uint32_t index = EG_ENTITY_INDEX(entity);
+
+  if (EG_COMP_STORAGES[comp] == EG_COMP_STORAGE_SPARSE) {
+    eg_comp_pool_t *pool = &entity_manager->pools[comp];
+
+    // Move the last component into the freed slot to keep the array packed
+    uint32_t slot = pool->sparse[index];
+    uint32_t last = --pool->dense_count;
+    if (slot != last) {
+      memcpy(
+          EG_COMP_AT(entity_manager, comp, slot),
+          EG_COMP_AT(entity_manager, comp, last),
+          EG_COMP_SIZES[comp]);
+      pool->dense_indices[slot]               = pool->dense_indices[last];
+      pool->sparse[pool->dense_indices[slot]] = slot;
+    }
+
+    pool->sparse[index] = UINT32_MAX;
   }
 
-  entity_manager->comp_masks[comp][entity] = false;
+  EG_BITSET_CLEAR(entity_manager->comp_masks[comp], index);
 }
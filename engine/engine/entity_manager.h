@@ -4,19 +4,74 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#define EG_MAX_ENTITIES 128
-
-#define EG_COMP_ARRAY(entity_manager, comp)                                    \
-  ((comp *)(entity_manager)->pools[EG_COMP_TYPE(comp)].data)
+// Amount of entities per storage chunk (must be a power of two)
+#define EG_ENTITY_CHUNK_SIZE 1024
+
+/*
+ * Entity handles pack a slot index in the low bits and the slot's generation
+ * in the high bits. The generation is bumped every time a slot is freed, so
+ * handles to removed entities are detected by eg_entity_exists even after
+ * the slot gets reused. A slot whose generation reaches the all-ones value is
+ * retired rather than wrapped around, so stale handles never become valid
+ * again, and the all-ones generation is never handed out, which keeps
+ * EG_NULL_ENTITY and the values close to it free for other uses.
+ */
+#define EG_ENTITY_INDEX_BITS 22
+#define EG_ENTITY_INDEX_MASK ((1U << EG_ENTITY_INDEX_BITS) - 1)
+#define EG_ENTITY_GENERATION_MASK ((1U << (32 - EG_ENTITY_INDEX_BITS)) - 1)
+#define EG_MAX_ENTITIES (EG_ENTITY_INDEX_MASK + 1)
+
+#define EG_NULL_ENTITY UINT32_MAX
+
+#define EG_ENTITY_INDEX(entity) ((entity)&EG_ENTITY_INDEX_MASK)
+#define EG_ENTITY_GENERATION(entity) ((entity) >> EG_ENTITY_INDEX_BITS)
+
+// Pointer to the component in storage slot `slot` (the entity index for dense
+// storage, the dense index for sparse set storage)
+#define EG_COMP_AT(entity_manager, comp_id, slot)                              \
+  (&(entity_manager)                                                           \
+        ->pools[comp_id]                                                       \
+        .chunks[(slot) / EG_ENTITY_CHUNK_SIZE]                                 \
+               [((slot) % EG_ENTITY_CHUNK_SIZE) * EG_COMP_SIZES[comp_id]])
 
 #define EG_COMP_BY_ID(entity_manager, entity, comp_id)                         \
-  (&(entity_manager)->pools[comp_id].data[entity * EG_COMP_SIZES[comp_id]])
+  eg_comp_get(entity_manager, entity, comp_id)
 
 #define EG_COMP(entity_manager, entity, comp)                                  \
   ((comp *)EG_COMP_BY_ID(entity_manager, entity, EG_COMP_TYPE(comp)))
 
+/*
+ * Dense iteration over a component type with sparse set storage. Indices go
+ * from 0 to EG_COMP_COUNT - 1 and only visit entities that have the component.
+ */
+#define EG_COMP_COUNT(entity_manager, comp)                                    \
+  ((entity_manager)->pools[EG_COMP_TYPE(comp)].dense_count)
+
+#define EG_COMP_DENSE(entity_manager, comp, i)                                 \
+  ((comp *)EG_COMP_AT(entity_manager, EG_COMP_TYPE(comp), i))
+
+#define EG_COMP_DENSE_ENTITY(entity_manager, comp, i)                          \
+  eg_entity_from_index(                                                        \
+      entity_manager,                                                          \
+      (entity_manager)->pools[EG_COMP_TYPE(comp)].dense_indices[i])
+
+/*
+ * Component, tag and existence masks are stored as one bitset per component
+ * type / tag, with a bit for each entity slot. Queries AND the bitsets a word
+ * at a time, skipping 64 non-matching entities per word.
+ */
+#define EG_BITSET_WORDS(bit_count) (((bit_count) + 63) / 64)
+
+#define EG_BITSET_AT(bitset, pos) (((bitset)[(pos) / 64] >> ((pos) % 64)) & 1)
+
+#define EG_BITSET_SET(bitset, pos)                                             \
+  ((bitset)[(pos) / 64] |= 1ULL << ((pos) % 64))
+
+#define EG_BITSET_CLEAR(bitset, pos)                                           \
+  ((bitset)[(pos) / 64] &= ~(1ULL << ((pos) % 64)))
+
 #define EG_HAS_COMP_ID(entity_manager, entity, comp_id)                        \
-  ((entity_manager)->comp_masks[comp_id][entity])
+  EG_BITSET_AT((entity_manager)->comp_masks[comp_id], EG_ENTITY_INDEX(entity))
 
 #define EG_HAS_COMP(entity_manager, entity, comp)                              \
   EG_HAS_COMP_ID(entity_manager, entity, EG_COMP_TYPE(comp))
@@ -27,62 +82,147 @@
 #define EG_REMOVE_COMP(entity_manager, entity, comp)                           \
   eg_comp_remove((entity_manager), entity, EG_COMP_TYPE(comp))
 
-#define EG_TAGS(entity_manager, entity) ((entity_manager)->tags[entity])
-
 #define EG_HAS_TAG(entity_manager, entity, tag)                                \
-  ((entity_manager)->tags[entity] & (1ULL << tag))
+  EG_BITSET_AT((entity_manager)->tag_masks[tag], EG_ENTITY_INDEX(entity))
 
 #define EG_ADD_TAG(entity_manager, entity, tag)                                \
   do {                                                                         \
-    assert(entity < EG_MAX_ENTITIES);                                          \
-    ((entity_manager)->tags[entity] |= (1ULL << tag));                         \
+    assert(EG_ENTITY_INDEX(entity) < (entity_manager)->entity_max);            \
+    EG_BITSET_SET((entity_manager)->tag_masks[tag], EG_ENTITY_INDEX(entity));  \
   } while (0)
 
 #define EG_REMOVE_TAG(entity_manager, entity, tag)                             \
   do {                                                                         \
-    assert(entity < EG_MAX_ENTITIES);                                          \
-    ((entity_manager)->tags[entity] &= ~(1ULL << tag));                        \
+    assert(EG_ENTITY_INDEX(entity) < (entity_manager)->entity_max);            \
+    EG_BITSET_CLEAR(                                                           \
+        (entity_manager)->tag_masks[tag], EG_ENTITY_INDEX(entity));            \
   } while (0)
 
 #define EG_SET_TAG(entity_manager, entity, tag, value)                         \
   do {                                                                         \
-    assert(entity < EG_MAX_ENTITIES);                                          \
-    ((entity_manager)->tags[entity] ^=                                         \
-     (-(eg_entity_tag_t)value ^ (entity_manager)->tags[entity]) &              \
-     (1ULL << tag));                                                           \
+    if (value) {                                                               \
+      EG_ADD_TAG(entity_manager, entity, tag);                                 \
+    } else {                                                                   \
+      EG_REMOVE_TAG(entity_manager, entity, tag);                              \
+    }                                                                          \
   } while (0)
 
+// Bits for the masks in eg_query_t
+#define EG_COMP_BIT(comp) (1ULL << EG_COMP_TYPE(comp))
+#define EG_TAG_BIT(tag) (1ULL << (tag))
+
 typedef uint32_t eg_entity_t;
 typedef uint64_t eg_entity_tag_t;
 
+// Selects entities that have all of the `all_*` bits and none of the `none_*`
+// bits set (see EG_COMP_BIT and EG_TAG_BIT)
+typedef struct eg_query_t {
+  uint64_t all_comps;
+  uint64_t none_comps;
+  uint64_t all_tags;
+  uint64_t none_tags;
+} eg_query_t;
+
+typedef struct eg_query_iter_t {
+  struct eg_entity_manager_t *entity_manager;
+  eg_query_t query;
+  uint32_t word;     // Index of the next bitset word to test
+  uint32_t word_end; // One past the last bitset word to test
+  uint64_t matches;  // Remaining matches in the current word
+} eg_query_iter_t;
+
 typedef struct eg_comp_pool_t {
-  uint8_t *data;
+  // Components are stored in fixed-size chunks that are never moved, so
+  // component pointers stay valid when the pool grows. With sparse set
+  // storage, removing a component moves the last one in the dense array into
+  // the freed slot, see eg_comp_remove.
+  uint8_t **chunks;
+  uint32_t chunk_count;
+
+  // Only used with EG_COMP_STORAGE_SPARSE
+  uint32_t *sparse;        // Entity index -> dense index, or UINT32_MAX
+  uint32_t *dense_indices; // Dense index -> entity index
+  uint32_t dense_count;
 } eg_comp_pool_t;
 
 typedef struct eg_entity_manager_t {
-  eg_entity_t entity_max; // Largest entity index + 1
+  uint32_t entity_max; // Largest entity index ever used + 1
+  uint32_t entity_cap; // Amount of allocated entity slots
 
   eg_comp_pool_t pools[EG_COMP_TYPE_MAX];
-  bool comp_masks[EG_COMP_TYPE_MAX][EG_MAX_ENTITIES];
-  bool existence[EG_MAX_ENTITIES];
-  eg_entity_tag_t tags[EG_MAX_ENTITIES];
+  uint64_t *comp_masks[EG_COMP_TYPE_MAX];
+  uint64_t *tag_masks[EG_TAG_MAX];
+  uint64_t *existence;
+  uint16_t *generations;
+
+  // Stack of removed entity indices, reused by eg_entity_add
+  uint32_t *free_indices;
+  uint32_t free_count;
 } eg_entity_manager_t;
 
 void eg_entity_manager_init(eg_entity_manager_t *entity_manager);
 
 void eg_entity_manager_destroy(eg_entity_manager_t *entity_manager);
 
+// Makes sure there are at least `count` allocated entity slots
+void eg_entity_manager_reserve(
+    eg_entity_manager_t *entity_manager, uint32_t count);
+
 eg_entity_t eg_entity_add(eg_entity_manager_t *entity_manager);
 
 void eg_entity_remove(eg_entity_manager_t *entity_manager, eg_entity_t entity);
 
 bool eg_entity_exists(eg_entity_manager_t *entity_manager, eg_entity_t entity);
 
+// Returns the handle of the live entity at `index`, or EG_NULL_ENTITY
+static inline eg_entity_t
+eg_entity_from_index(eg_entity_manager_t *entity_manager, uint32_t index) {
+  if (!EG_BITSET_AT(entity_manager->existence, index)) return EG_NULL_ENTITY;
+  return index | ((eg_entity_t)entity_manager->generations[index]
+                  << EG_ENTITY_INDEX_BITS);
+}
+
+// For sparse set storage, returns NULL if the entity doesn't have the
+// component (dense storage always has a slot for it)
+static inline void *eg_comp_get(
+    eg_entity_manager_t *entity_manager,
+    eg_entity_t entity,
+    eg_comp_type_t comp) {
+  uint32_t slot = EG_ENTITY_INDEX(entity);
+  if (EG_COMP_STORAGES[comp] == EG_COMP_STORAGE_SPARSE) {
+    slot = entity_manager->pools[comp].sparse[slot];
+    if (slot == UINT32_MAX) return NULL;
+  }
+  return EG_COMP_AT(entity_manager, comp, slot);
+}
+
+eg_entity_tag_t
+eg_entity_get_tags(eg_entity_manager_t *entity_manager, eg_entity_t entity);
+
+void eg_entity_set_tags(
+    eg_entity_manager_t *entity_manager,
+    eg_entity_t entity,
+    eg_entity_tag_t tags);
+
+eg_query_iter_t
+eg_query_iter(eg_entity_manager_t *entity_manager, const eg_query_t *query);
+
+// Stores the next matching entity in `entity`, returns false when there are
+// no more matches
+bool eg_query_next(eg_query_iter_t *iter, eg_entity_t *entity);
+
 void *eg_comp_add(
     eg_entity_manager_t *entity_manager,
     eg_entity_t entity,
     eg_comp_type_t comp);
 
+/*
+ * Pointers to dense storage components stay valid until their own entity loses
+ * the component. Sparse set storage is the exception: to keep the dense array
+ * packed, the last component is moved into the removed one's slot, so removing
+ * a component of a sparse type invalidates the pointers to every component of
+ * that type. Look them up again with EG_COMP after a removal.
+ */
 void eg_comp_remove(
     eg_entity_manager_t *entity_manager,
     eg_entity_t entity,
@@ -1,6 +1,8 @@
 #include "environment.h"
 
+#include "asset_manager.h"
 #include "assets/image_asset.h"
+#include "engine.h"
 #include "pipelines.h"
 #include <fstd_util.h>
 #include <renderer/context.h>
@@ -12,6 +14,15 @@
 // For skybox pipeline
 #define ENVIRONMENT_SET_INDEX 1
 
+// Environment maps that are still loading are drawn as the fallback
+static re_image_t *
+get_image(eg_image_asset_t *image_asset, re_image_t *fallback) {
+  if (eg_asset_is_ready((eg_asset_t *)image_asset)) {
+    return &image_asset->image;
+  }
+  return fallback;
+}
+
 void eg_environment_init(
     eg_environment_t *environment,
     eg_image_asset_t *skybox,
@@ -23,6 +34,11 @@ void eg_environment_init(
   environment->radiance   = radiance;
   environment->brdf       = brdf;
 
+  eg_asset_retain((eg_asset_t *)skybox);
+  eg_asset_retain((eg_asset_t *)irradiance);
+  eg_asset_retain((eg_asset_t *)radiance);
+  eg_asset_retain((eg_asset_t *)brdf);
+
   environment->skybox_type = EG_SKYBOX_DEFAULT;
 
   environment->uniform.sun_direction       = (vec3_t){0.0, -1.0, 0.0};
@@ -31,9 +47,6 @@ void eg_environment_init(
   environment->uniform.sun_intensity       = 1.0f;
   environment->uniform.radiance_mip_levels = 1.0f;
   environment->uniform.point_light_count   = 0;
-
-  environment->uniform.radiance_mip_levels =
-      (float)environment->radiance->image.mip_level_count;
 }
 
 void eg_environment_bind(
@@ -43,13 +56,22 @@ void eg_environment_bind(
     uint32_t set) {
   re_cmd_bind_pipeline(cmd_buffer, pipeline);
 
+  re_image_t *radiance = get_image(environment->radiance, &g_eng.black_cubemap);
+
+  environment->uniform.radiance_mip_levels = (float)radiance->mip_level_count;
+
   void *mapping =
       re_cmd_bind_uniform(cmd_buffer, set, 0, sizeof(environment->uniform));
   memcpy(mapping, &environment->uniform, sizeof(environment->uniform));
 
-  re_cmd_bind_image(cmd_buffer, set, 1, &environment->irradiance->image);
-  re_cmd_bind_image(cmd_buffer, set, 2, &environment->radiance->image);
-  re_cmd_bind_image(cmd_buffer, set, 3, &environment->brdf->image);
+  re_cmd_bind_image(
+      cmd_buffer,
+      set,
+      1,
+      get_image(environment->irradiance, &g_eng.black_cubemap));
+  re_cmd_bind_image(cmd_buffer, set, 2, radiance);
+  re_cmd_bind_image(
+      cmd_buffer, set, 3, get_image(environment->brdf, &g_eng.black_texture));
 
   re_cmd_bind_descriptor_set(cmd_buffer, pipeline, set);
 }
@@ -66,10 +88,15 @@ void eg_environment_draw_skybox(
 
   switch (environment->skybox_type) {
   case EG_SKYBOX_DEFAULT:
-    re_cmd_bind_image(cmd_buffer, 1, 1, &environment->skybox->image);
+    re_cmd_bind_image(
+        cmd_buffer, 1, 1, get_image(environment->skybox, &g_eng.black_cubemap));
     break;
   case EG_SKYBOX_IRRADIANCE:
-    re_cmd_bind_image(cmd_buffer, 1, 1, &environment->irradiance->image);
+    re_cmd_bind_image(
+        cmd_buffer,
+        1,
+        1,
+        get_image(environment->irradiance, &g_eng.black_cubemap));
     break;
   }
 
@@ -94,4 +121,9 @@ void eg_environment_reset_point_lights(eg_environment_t *environment) {
   environment->uniform.point_light_count = 0;
 }
 
-void eg_environment_destroy(eg_environment_t *environment) {}
+void eg_environment_destroy(eg_environment_t *environment) {
+  eg_asset_release((eg_asset_t *)environment->skybox);
+  eg_asset_release((eg_asset_t *)environment->irradiance);
+  eg_asset_release((eg_asset_t *)environment->radiance);
+  eg_asset_release((eg_asset_t *)environment->brdf);
+}
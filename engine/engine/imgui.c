@@ -168,6 +168,8 @@ static void create_or_resize_buffer(
     return;
   }
   if (buffer->size < size) {
+    // Each frame in flight has its own buffers, and the window already waited
+    // for the frame that last used this one
     re_buffer_destroy(buffer);
     re_buffer_init(
         buffer,
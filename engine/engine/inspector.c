@@ -83,7 +83,7 @@ void eg_inspector_init(
     eg_asset_manager_t *asset_manager) {
   memset(inspector, 0, sizeof(*inspector));
 
-  inspector->selected_entity       = UINT32_MAX;
+  inspector->selected_entity       = EG_NULL_ENTITY;
   inspector->window                = window;
   inspector->scene                 = scene;
   inspector->asset_manager         = asset_manager;
@@ -221,6 +221,8 @@ void eg_inspector_init(
 }
 
 void eg_inspector_destroy(eg_inspector_t *inspector) {
+  VK_CHECK(vkDeviceWaitIdle(g_ctx.device));
+
   re_buffer_destroy(&inspector->pos_gizmo_vertex_buffer);
   re_buffer_destroy(&inspector->pos_gizmo_index_buffer);
 
@@ -251,40 +253,36 @@ draw_gizmos_picking(eg_inspector_t *inspector, re_cmd_buffer_t *cmd_buffer) {
   re_cmd_bind_image(cmd_buffer, 1, 0, &inspector->light_billboard_image);
   re_cmd_bind_descriptor_set(cmd_buffer, &inspector->billboard_pipeline, 1);
 
-  eg_transform_comp_t *transforms =
-      EG_COMP_ARRAY(entity_manager, eg_transform_comp_t);
-
-  for (eg_entity_t e = 0; e < entity_manager->entity_max; e++) {
-    if (!eg_entity_exists(entity_manager, e)) {
-      continue;
-    }
-
-    if (EG_HAS_TAG(entity_manager, e, EG_TAG_HIDDEN)) {
-      continue;
-    }
+  eg_query_iter_t iter = eg_query_iter(
+      entity_manager,
+      &(eg_query_t){
+          .all_comps = EG_COMP_BIT(eg_point_light_comp_t) |
+                       EG_COMP_BIT(eg_transform_comp_t),
+          .none_tags = EG_TAG_BIT(EG_TAG_HIDDEN),
+      });
 
-    if (EG_HAS_COMP(entity_manager, e, eg_point_light_comp_t) &&
-        EG_HAS_COMP(entity_manager, e, eg_transform_comp_t)) {
-      struct {
-        mat4_t model;
-        uint32_t index;
-      } push_constant;
+  eg_entity_t e;
+  while (eg_query_next(&iter, &e)) {
+    struct {
+      mat4_t model;
+      uint32_t index;
+    } push_constant;
 
-      push_constant.model = eg_transform_comp_mat4(&transforms[e]);
-      push_constant.index = e;
+    push_constant.model = eg_transform_system_world(
+        &inspector->scene->transform_system, e);
+    push_constant.index = e;
 
-      re_cmd_push_constants(
-          cmd_buffer,
-          &inspector->billboard_picking_pipeline,
-          0,
-          sizeof(push_constant),
-          &push_constant);
+    re_cmd_push_constants(
+        cmd_buffer,
+        &inspector->billboard_picking_pipeline,
+        0,
+        sizeof(push_constant),
+        &push_constant);
 
-      re_cmd_draw(cmd_buffer, 6, 1, 0, 0);
-    }
+    re_cmd_draw(cmd_buffer, 6, 1, 0, 0);
   }
 
-  if (inspector->selected_entity >= EG_MAX_ENTITIES) {
+  if (!eg_entity_exists(entity_manager, inspector->selected_entity)) {
     return;
   }
 
@@ -325,10 +323,8 @@ draw_gizmos_picking(eg_inspector_t *inspector, re_cmd_buffer_t *cmd_buffer) {
     uint32_t index;
   } push_constant;
 
-  eg_transform_comp_t *transform =
-      EG_COMP(entity_manager, inspector->selected_entity, eg_transform_comp_t);
-
-  mat4_t object_mat = eg_transform_comp_mat4(transform);
+  mat4_t object_mat = eg_transform_system_world(
+      &inspector->scene->transform_system, inspector->selected_entity);
 
   uint32_t color_indices[] = {
       EG_DRAG_DIRECTION_X, EG_DRAG_DIRECTION_Y, EG_DRAG_DIRECTION_Z};
@@ -375,29 +371,25 @@ static void mouse_pressed(eg_inspector_t *inspector) {
   eg_camera_bind(
       &inspector->scene->camera, cmd_buffer, &inspector->picking_pipeline, 0);
 
-  eg_transform_comp_t *transforms =
-      EG_COMP_ARRAY(entity_manager, eg_transform_comp_t);
-  eg_gltf_comp_t *gltf_models = EG_COMP_ARRAY(entity_manager, eg_gltf_comp_t);
-  eg_mesh_comp_t *meshes      = EG_COMP_ARRAY(entity_manager, eg_mesh_comp_t);
-
 #define PUSH_CONSTANT()                                                        \
   re_cmd_push_constants(                                                       \
       cmd_buffer, &inspector->picking_pipeline, 0, sizeof(uint32_t), &e);
 
-  for (eg_entity_t e = 0; e < entity_manager->entity_max; e++) {
-    if (!eg_entity_exists(entity_manager, e)) {
-      continue;
-    }
+  eg_query_iter_t iter = eg_query_iter(
+      entity_manager,
+      &(eg_query_t){.all_comps = EG_COMP_BIT(eg_transform_comp_t)});
 
+  eg_entity_t e;
+  while (eg_query_next(&iter, &e)) {
     if (EG_HAS_COMP(entity_manager, e, eg_mesh_comp_t) &&
         EG_HAS_COMP(entity_manager, e, eg_transform_comp_t)) {
       PUSH_CONSTANT();
 
       eg_mesh_comp_draw_no_mat(
-          &meshes[e],
+          EG_COMP(entity_manager, e, eg_mesh_comp_t),
           cmd_buffer,
           &inspector->picking_pipeline,
-          eg_transform_comp_mat4(&transforms[e]));
+          eg_transform_system_world(&inspector->scene->transform_system, e));
     }
 
     if (EG_HAS_COMP(entity_manager, e, eg_gltf_comp_t) &&
@@ -405,10 +397,10 @@ static void mouse_pressed(eg_inspector_t *inspector) {
       PUSH_CONSTANT();
 
       eg_gltf_comp_draw_no_mat(
-          &gltf_models[e],
+          EG_COMP(entity_manager, e, eg_gltf_comp_t),
           cmd_buffer,
           &inspector->picking_pipeline,
-          eg_transform_comp_mat4(&transforms[e]));
+          eg_transform_system_world(&inspector->scene->transform_system, e));
     }
   }
 
@@ -435,13 +427,15 @@ static void mouse_pressed(eg_inspector_t *inspector) {
   }
   }
 
-  if (inspector->selected_entity < EG_MAX_ENTITIES &&
+  if (eg_entity_exists(entity_manager, inspector->selected_entity) &&
       EG_HAS_COMP(
           entity_manager, inspector->selected_entity, eg_transform_comp_t)) {
     eg_transform_comp_t *transform = EG_COMP(
         entity_manager, inspector->selected_entity, eg_transform_comp_t);
+    mat4_t world = eg_transform_system_world(
+        &inspector->scene->transform_system, inspector->selected_entity);
     vec3_t transform_ndc =
-        eg_camera_world_to_ndc(&inspector->scene->camera, transform->position);
+        eg_camera_world_to_ndc(&inspector->scene->camera, world.v[3].xyz);
 
     float width  = (float)inspector->drawing_render_target->width;
     float height = (float)inspector->drawing_render_target->height;
@@ -487,7 +481,7 @@ void eg_inspector_update(eg_inspector_t *inspector) {
   eg_entity_manager_t *entity_manager = &inspector->scene->entity_manager;
 
   if (inspector->drag_direction == EG_DRAG_DIRECTION_NONE ||
-      inspector->selected_entity >= EG_MAX_ENTITIES ||
+      !eg_entity_exists(entity_manager, inspector->selected_entity) ||
       !EG_HAS_COMP(
           entity_manager, inspector->selected_entity, eg_transform_comp_t)) {
     return;
@@ -495,8 +489,10 @@ void eg_inspector_update(eg_inspector_t *inspector) {
 
   eg_transform_comp_t *transform =
       EG_COMP(entity_manager, inspector->selected_entity, eg_transform_comp_t);
+  mat4_t world = eg_transform_system_world(
+      &inspector->scene->transform_system, inspector->selected_entity);
   vec3_t transform_ndc =
-      eg_camera_world_to_ndc(&inspector->scene->camera, transform->position);
+      eg_camera_world_to_ndc(&inspector->scene->camera, world.v[3].xyz);
 
   double cursor_x, cursor_y;
   re_window_get_cursor_pos(inspector->window, &cursor_x, &cursor_y);
@@ -529,6 +525,8 @@ void eg_inspector_update(eg_inspector_t *inspector) {
     break;
   }
   }
+
+  transform->dirty = true;
 }
 
 void eg_inspector_draw_gizmos(
@@ -543,37 +541,35 @@ void eg_inspector_draw_gizmos(
   re_cmd_bind_image(cmd_buffer, 1, 0, &inspector->light_billboard_image);
   re_cmd_bind_descriptor_set(cmd_buffer, &inspector->billboard_pipeline, 1);
 
-  eg_transform_comp_t *transforms =
-      EG_COMP_ARRAY(entity_manager, eg_transform_comp_t);
-  eg_point_light_comp_t *point_lights =
-      EG_COMP_ARRAY(entity_manager, eg_point_light_comp_t);
-
   static eg_entity_t light_entities[EG_MAX_POINT_LIGHTS];
   uint32_t light_count = 0;
 
-  for (eg_entity_t e = 0; e < entity_manager->entity_max; e++) {
-    if (!eg_entity_exists(entity_manager, e)) {
-      continue;
-    }
-
-    if (EG_HAS_TAG(entity_manager, e, EG_TAG_HIDDEN)) {
-      continue;
-    }
+  eg_query_iter_t iter = eg_query_iter(
+      entity_manager,
+      &(eg_query_t){
+          .all_comps = EG_COMP_BIT(eg_point_light_comp_t) |
+                       EG_COMP_BIT(eg_transform_comp_t),
+          .none_tags = EG_TAG_BIT(EG_TAG_HIDDEN),
+      });
 
-    if (EG_HAS_COMP(entity_manager, e, eg_point_light_comp_t) &&
-        EG_HAS_COMP(entity_manager, e, eg_transform_comp_t)) {
-      light_entities[light_count++] = e;
-    }
+  eg_entity_t e;
+  while (light_count < EG_MAX_POINT_LIGHTS && eg_query_next(&iter, &e)) {
+    light_entities[light_count++] = e;
   }
 
   // Draw call sorting
   for (uint32_t i = 0; i < light_count; i++) {
     for (uint32_t j = 0; j < light_count - i; j++) {
+      eg_transform_comp_t *transform_i =
+          EG_COMP(entity_manager, light_entities[i], eg_transform_comp_t);
+      eg_transform_comp_t *transform_j =
+          EG_COMP(entity_manager, light_entities[j], eg_transform_comp_t);
+
       if (vec3_distance(
-              transforms[light_entities[i]].position,
+              transform_i->position,
               inspector->scene->camera.uniform.pos.xyz) >
           vec3_distance(
-              transforms[light_entities[j]].position,
+              transform_j->position,
               inspector->scene->camera.uniform.pos.xyz)) {
         eg_entity_t t     = light_entities[i];
         light_entities[i] = light_entities[j];
@@ -588,9 +584,11 @@ void eg_inspector_draw_gizmos(
       vec4_t color;
     } push_constant;
 
-    push_constant.model =
-        eg_transform_comp_mat4(&transforms[light_entities[i]]);
-    push_constant.color = point_lights[light_entities[i]].color;
+    push_constant.model = eg_transform_system_world(
+        &inspector->scene->transform_system, light_entities[i]);
+    push_constant.color =
+        EG_COMP(entity_manager, light_entities[i], eg_point_light_comp_t)
+            ->color;
 
     re_cmd_push_constants(
         cmd_buffer,
@@ -602,7 +600,7 @@ void eg_inspector_draw_gizmos(
     re_cmd_draw(cmd_buffer, 6, 1, 0, 0);
   }
 
-  if (inspector->selected_entity >= EG_MAX_ENTITIES) {
+  if (!eg_entity_exists(entity_manager, inspector->selected_entity)) {
     return;
   }
 
@@ -643,10 +641,8 @@ void eg_inspector_draw_gizmos(
     vec4_t color;
   } push_constant;
 
-  eg_transform_comp_t *transform =
-      EG_COMP(entity_manager, inspector->selected_entity, eg_transform_comp_t);
-
-  mat4_t object_mat = eg_transform_comp_mat4(transform);
+  mat4_t object_mat = eg_transform_system_world(
+      &inspector->scene->transform_system, inspector->selected_entity);
 
   vec4_t colors[] = {{1.0f, 0.0f, 0.0f, 0.5f},
                      {0.0f, 1.0f, 0.0f, 0.5f},
@@ -691,36 +687,34 @@ void eg_inspector_draw_selected_outline(
   re_cmd_push_constants(
       cmd_buffer, &inspector->outline_pipeline, 0, sizeof(color), &color);
 
-  if (inspector->selected_entity < EG_MAX_ENTITIES &&
+  if (eg_entity_exists(entity_manager, inspector->selected_entity) &&
       EG_HAS_COMP(entity_manager, inspector->selected_entity, eg_gltf_comp_t) &&
       EG_HAS_COMP(
           entity_manager, inspector->selected_entity, eg_transform_comp_t)) {
     eg_gltf_comp_t *model =
         EG_COMP(entity_manager, inspector->selected_entity, eg_gltf_comp_t);
-    eg_transform_comp_t *transform = EG_COMP(
-        entity_manager, inspector->selected_entity, eg_transform_comp_t);
 
     eg_gltf_comp_draw_no_mat(
         model,
         cmd_buffer,
         &inspector->outline_pipeline,
-        eg_transform_comp_mat4(transform));
+        eg_transform_system_world(
+            &inspector->scene->transform_system, inspector->selected_entity));
   }
 
-  if (inspector->selected_entity < EG_MAX_ENTITIES &&
+  if (eg_entity_exists(entity_manager, inspector->selected_entity) &&
       EG_HAS_COMP(entity_manager, inspector->selected_entity, eg_mesh_comp_t) &&
       EG_HAS_COMP(
           entity_manager, inspector->selected_entity, eg_transform_comp_t)) {
     eg_mesh_comp_t *mesh =
         EG_COMP(entity_manager, inspector->selected_entity, eg_mesh_comp_t);
-    eg_transform_comp_t *transform = EG_COMP(
-        entity_manager, inspector->selected_entity, eg_transform_comp_t);
 
     eg_mesh_comp_draw_no_mat(
         mesh,
         cmd_buffer,
         &inspector->outline_pipeline,
-        eg_transform_comp_mat4(transform));
+        eg_transform_system_world(
+            &inspector->scene->transform_system, inspector->selected_entity));
   }
 }
 
@@ -779,7 +773,7 @@ static void inspect_environment(eg_environment_t *environment) {
   }
 }
 
-static void inspect_statistics(re_window_t *window) {
+static void inspect_statistics(eg_scene_t *scene, re_window_t *window) {
   igText("Delta time: %.4fms", window->delta_time);
   igText("FPS: %.2f", 1.0f / window->delta_time);
   igText("");
@@ -840,6 +834,13 @@ static void inspect_statistics(re_window_t *window) {
     }
     igText("UBO pool: %u nodes", node_count);
   }
+
+  igText("");
+
+  igText(
+      "Transforms recomputed: %u/%u",
+      scene->transform_system.recompute_count,
+      scene->transform_system.transform_count);
 }
 
 static void inspect_settings(eg_inspector_t *inspector) {
@@ -849,6 +850,7 @@ static void inspect_settings(eg_inspector_t *inspector) {
 
 void add_component_button(eg_inspector_t *inspector, eg_entity_t entity) {
   eg_entity_manager_t *entity_manager = &inspector->scene->entity_manager;
+  eg_ecs_cmd_buffer_t *cmd_buffer     = &inspector->scene->cmd_buffer;
 
   if (igButton(
           "Add component", (ImVec2){igGetContentRegionAvailWidth(), 30.0f})) {
@@ -862,7 +864,7 @@ void add_component_button(eg_inspector_t *inspector, eg_entity_t entity) {
       }
       if (igSelectable(
               EG_COMP_NAMES[comp_id], false, 0, (ImVec2){0.0f, 0.0f})) {
-        eg_comp_add(entity_manager, entity, comp_id);
+        eg_ecs_cmd_add_comp(cmd_buffer, entity, comp_id);
       }
     }
 
@@ -892,7 +894,8 @@ void eg_inspector_draw_ui(eg_inspector_t *inspector) {
       }
 
       if (igMenuItemBool("Load", NULL, false, true)) {
-        for (eg_entity_t e = 0; e < entity_manager->entity_max; e++) {
+        for (uint32_t i = 0; i < entity_manager->entity_max; i++) {
+          eg_entity_t e = eg_entity_from_index(entity_manager, i);
           eg_entity_remove(entity_manager, e);
         }
 
@@ -901,8 +904,6 @@ void eg_inspector_draw_ui(eg_inspector_t *inspector) {
           eg_asset_manager_free(asset_manager, asset);
         }
 
-        VK_CHECK(vkDeviceWaitIdle(g_ctx.device));
-
         eg_deserializer_t deserializer;
         eg_deserializer_init(&deserializer);
 
@@ -935,7 +936,7 @@ void eg_inspector_draw_ui(eg_inspector_t *inspector) {
       }
 
       if (igBeginTabItem("Statistics", NULL, 0)) {
-        inspect_statistics(window);
+        inspect_statistics(scene, window);
 
         igEndTabItem();
       }
@@ -944,16 +945,16 @@ void eg_inspector_draw_ui(eg_inspector_t *inspector) {
         if (igButton(
                 "Add entity",
                 (ImVec2){igGetContentRegionAvailWidth(), 30.0f})) {
-          eg_entity_add(entity_manager);
+          eg_ecs_cmd_add_entity(&scene->cmd_buffer);
         }
 
-        for (eg_entity_t entity = 0; entity < entity_manager->entity_max;
-             entity++) {
-          if (!eg_entity_exists(entity_manager, entity)) {
+        for (uint32_t i = 0; i < entity_manager->entity_max; i++) {
+          eg_entity_t entity = eg_entity_from_index(entity_manager, i);
+          if (entity == EG_NULL_ENTITY) {
             continue;
           }
 
-          snprintf(str, sizeof(str), "Entity #%d", entity);
+          snprintf(str, sizeof(str), "Entity #%u", EG_ENTITY_INDEX(entity));
           if (igSelectable(
                   str,
                   inspector->selected_entity == entity,
@@ -1041,6 +1042,12 @@ void eg_inspector_draw_ui(eg_inspector_t *inspector) {
           selected_asset_type = EG_ASSET_TYPE_MAX;
         }
 
+        igText(
+            "Async loads: %u loaded, %u reused",
+            atomic_load(&asset_manager->load_misses),
+            atomic_load(&asset_manager->load_hits));
+        igSeparator();
+
         for (uint32_t i = 0; i < asset_manager->count; i++) {
           eg_asset_t *asset = eg_asset_manager_get(asset_manager, i);
           if (asset == NULL) {
@@ -1057,7 +1064,11 @@ void eg_inspector_draw_ui(eg_inspector_t *inspector) {
               eg_asset_get_name(asset),
               asset->uid);
           if (igCollapsingHeader(str, 0)) {
-            EG_ASSET_INSPECTORS[asset->type](asset, inspector);
+            switch (eg_asset_get_state(asset)) {
+            case EG_ASSET_STATE_PENDING: igText("Loading..."); break;
+            case EG_ASSET_STATE_FAILED: igText("Failed to load"); break;
+            default: EG_ASSET_INSPECTORS[asset->type](asset, inspector); break;
+            }
           }
 
           igPopID();
@@ -1086,11 +1097,12 @@ void eg_inspector_draw_ui(eg_inspector_t *inspector) {
   if (igBegin("Selected entity", NULL, 0)) {
     eg_entity_t entity = inspector->selected_entity;
 
-    igText("Entity #%u", inspector->selected_entity);
+    igText("Entity #%u", EG_ENTITY_INDEX(inspector->selected_entity));
     igSameLine(0.0f, -1.0f);
     if (igSmallButton("Remove")) {
-      eg_entity_remove(entity_manager, inspector->selected_entity);
-      set_selected(inspector, UINT32_MAX);
+      eg_ecs_cmd_remove_entity(
+          &inspector->scene->cmd_buffer, inspector->selected_entity);
+      set_selected(inspector, EG_NULL_ENTITY);
       igEnd();
       return;
     }
@@ -1120,7 +1132,7 @@ void eg_inspector_draw_ui(eg_inspector_t *inspector) {
       igSameLine(igGetWindowWidth() - 25.0f, 0.0f);
 
       if (igSmallButton("×")) {
-        eg_comp_remove(entity_manager, entity, comp_id);
+        eg_ecs_cmd_remove_comp(&inspector->scene->cmd_buffer, entity, comp_id);
         igPopID();
         continue;
       }
@@ -43,6 +43,8 @@ static inline void eg_inspect_assets(
         if (cur_asset->type != type) continue;
 
         if (igSelectable(eg_asset_get_name(cur_asset), false, 0, (ImVec2){0})) {
+          eg_asset_retain(cur_asset);
+          eg_asset_release(*asset);
           *asset = cur_asset;
         }
       }
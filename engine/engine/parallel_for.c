@@ -0,0 +1,92 @@
+#include "parallel_for.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+typedef struct parallel_for_t {
+  eg_entity_manager_t *entity_manager;
+  const eg_entity_t *entities;
+  eg_parallel_for_fn_t fn;
+  void *userdata;
+} parallel_for_t;
+
+typedef struct parallel_for_chunk_t {
+  parallel_for_t *parallel_for;
+  uint32_t first;
+  uint32_t count;
+} parallel_for_chunk_t;
+
+static int chunk_task(void *args) {
+  parallel_for_chunk_t *chunk = args;
+  parallel_for_t *pf          = chunk->parallel_for;
+
+  pf->fn(
+      pf->entity_manager,
+      &pf->entities[chunk->first],
+      chunk->count,
+      pf->userdata);
+
+  return 0;
+}
+
+void eg_parallel_for_entities(
+    eg_task_scheduler_t *scheduler,
+    eg_entity_manager_t *entity_manager,
+    const eg_query_t *query,
+    uint32_t chunk_size,
+    eg_parallel_for_fn_t fn,
+    void *userdata) {
+  assert(chunk_size > 0);
+
+  // Gather the matching entities first, so that every chunk gets the same
+  // amount of work no matter how the matches are spread over the indices
+  eg_entity_t *entities =
+      malloc(entity_manager->entity_max * sizeof(*entities));
+  uint32_t entity_count = 0;
+
+  eg_query_iter_t iter = eg_query_iter(entity_manager, query);
+  eg_entity_t entity;
+  while (eg_query_next(&iter, &entity)) {
+    entities[entity_count++] = entity;
+  }
+
+  uint32_t chunk_count = (entity_count + chunk_size - 1) / chunk_size;
+
+  if (chunk_count <= 1 || scheduler == NULL || scheduler->num_workers == 0) {
+    if (entity_count > 0) {
+      fn(entity_manager, entities, entity_count, userdata);
+    }
+    free(entities);
+    return;
+  }
+
+  parallel_for_t pf = {
+      .entity_manager = entity_manager,
+      .entities       = entities,
+      .fn             = fn,
+      .userdata       = userdata,
+  };
+
+  parallel_for_chunk_t *chunks = malloc(chunk_count * sizeof(*chunks));
+  for (uint32_t i = 0; i < chunk_count; i++) {
+    chunks[i].parallel_for = &pf;
+    chunks[i].first        = i * chunk_size;
+    chunks[i].count        = chunk_size;
+  }
+  chunks[chunk_count - 1].count = entity_count - chunks[chunk_count - 1].first;
+
+  eg_task_group_t group;
+  eg_task_group_init(&group);
+
+  // The calling thread takes the first chunk, and then helps with the rest
+  // while waiting
+  for (uint32_t i = 1; i < chunk_count; i++) {
+    eg_scheduler_add_task_to_group(scheduler, &group, chunk_task, &chunks[i]);
+  }
+  chunk_task(&chunks[0]);
+
+  eg_task_group_wait(scheduler, &group);
+
+  free(chunks);
+  free(entities);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "entity_manager.h"
+#include "task_scheduler.h"
+
+/*
+ * Splits the entities matching a query into chunks of `chunk_size` entities
+ * and calls `fn` on each chunk from the scheduler's workers (and the calling
+ * thread), blocking until every chunk is done.
+ *
+ * `fn` may read and write the components of the entities it gets, but it must
+ * not add or remove entities or components: record those into an
+ * eg_ecs_cmd_buffer_t instead.
+ */
+
+typedef void (*eg_parallel_for_fn_t)(
+    eg_entity_manager_t *entity_manager,
+    const eg_entity_t *entities,
+    uint32_t count,
+    void *userdata);
+
+void eg_parallel_for_entities(
+    eg_task_scheduler_t *scheduler,
+    eg_entity_manager_t *entity_manager,
+    const eg_query_t *query,
+    uint32_t chunk_size,
+    eg_parallel_for_fn_t fn,
+    void *userdata);
@@ -15,13 +15,19 @@ void eg_scene_init(
   eg_environment_init(&scene->environment, skybox, irradiance, radiance, brdf);
 
   eg_entity_manager_init(&scene->entity_manager);
+  eg_ecs_cmd_buffer_init(&scene->cmd_buffer);
+
+  eg_transform_system_init(&scene->transform_system);
 }
 
 void eg_scene_destroy(eg_scene_t *scene) {
   eg_environment_destroy(&scene->environment);
   eg_camera_destroy(&scene->camera);
 
+  eg_ecs_cmd_buffer_destroy(&scene->cmd_buffer);
   eg_entity_manager_destroy(&scene->entity_manager);
+
+  eg_transform_system_destroy(&scene->transform_system);
 }
 
 enum {
@@ -99,6 +105,9 @@ void eg_scene_deserialize(eg_scene_t *scene, eg_deserializer_t *deserializer) {
     }
   }
 
+  // Drops the references to the previous environment maps
+  eg_environment_destroy(&scene->environment);
+
   eg_camera_init(&scene->camera);
   eg_environment_init(&scene->environment, skybox, irradiance, radiance, brdf);
   scene->environment.uniform = env_uniform;
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "camera.h"
+#include "ecs_cmd_buffer.h"
 #include "entity_manager.h"
 #include "environment.h"
+#include "systems/transform_system.h"
 
 typedef struct eg_serializer_t eg_serializer_t;
 typedef struct eg_deserializer_t eg_deserializer_t;
@@ -12,6 +14,9 @@ typedef struct eg_scene_t {
   eg_environment_t environment;
 
   eg_entity_manager_t entity_manager;
+  eg_ecs_cmd_buffer_t cmd_buffer; // Flushed once per frame, before the systems
+
+  eg_transform_system_t transform_system;
 } eg_scene_t;
 
 void eg_scene_init(
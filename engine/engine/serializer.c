@@ -42,9 +42,16 @@ void eg_serialize_scene(
     asset_count += 1;
   }
 
-  for (uint32_t e = 0; e < entity_manager->entity_max; e++) {
-    if (!eg_entity_exists(entity_manager, e)) continue;
-
+  // Entities get numbered in the order they're written, since their indices
+  // change when the scene is loaded
+  serializer->entity_manager = entity_manager;
+  serializer->entity_ids =
+      malloc(entity_manager->entity_max * sizeof(*serializer->entity_ids));
+
+  eg_entity_t e;
+  eg_query_iter_t iter = eg_query_iter(entity_manager, &(eg_query_t){0});
+  while (eg_query_next(&iter, &e)) {
+    serializer->entity_ids[EG_ENTITY_INDEX(e)] = entity_count;
     entity_count += 1;
   }
 
@@ -70,9 +77,8 @@ void eg_serialize_scene(
 
   eg_scene_serialize(scene, serializer);
 
-  for (uint32_t e = 0; e < entity_manager->entity_max; e++) {
-    if (!eg_entity_exists(entity_manager, e)) continue;
-
+  iter = eg_query_iter(entity_manager, &(eg_query_t){0});
+  while (eg_query_next(&iter, &e)) {
     uint32_t comp_count = 0;
 
     for (uint32_t c = 0; c < EG_COMP_TYPE_MAX; c++) {
@@ -82,7 +88,8 @@ void eg_serialize_scene(
     }
 
     // Tags
-    eg_serializer_append_u64(serializer, entity_manager->tags[e]);
+    eg_serializer_append_u64(
+        serializer, eg_entity_get_tags(entity_manager, e));
 
     // Component count
     eg_serializer_append_u32(serializer, comp_count);
@@ -102,6 +109,10 @@ void eg_serialize_scene(
       EG_COMP_SERIALIZERS[c](comp, serializer);
     }
   }
+
+  free(serializer->entity_ids);
+  serializer->entity_ids     = NULL;
+  serializer->entity_manager = NULL;
 }
 
 void eg_serializer_save(eg_serializer_t *serializer, const char *path) {
@@ -146,3 +157,15 @@ void eg_serializer_append_u32(eg_serializer_t *serializer, uint32_t data) {
 void eg_serializer_append_u64(eg_serializer_t *serializer, uint64_t data) {
   eg_serializer_append(serializer, &data, sizeof(data));
 }
+
+void eg_serializer_append_entity(
+    eg_serializer_t *serializer, eg_entity_t entity) {
+  assert(serializer->entity_manager != NULL);
+
+  uint32_t id = UINT32_MAX;
+  if (eg_entity_exists(serializer->entity_manager, entity)) {
+    id = serializer->entity_ids[EG_ENTITY_INDEX(entity)];
+  }
+
+  eg_serializer_append_u32(serializer, id);
+}
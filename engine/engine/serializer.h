@@ -2,15 +2,19 @@
 
 #include "assets/asset_types.h"
 #include "comps/comp_types.h"
+#include "entity_manager.h"
 
 typedef struct eg_scene_t eg_scene_t;
-typedef struct eg_entity_manager_t eg_entity_manager_t;
 typedef struct eg_asset_manager_t eg_asset_manager_t;
 
 typedef struct eg_serializer_t {
   uint8_t *buffer;
   size_t buffer_offset;
   size_t buffer_size;
+
+  // Only set while serializing a scene
+  eg_entity_manager_t *entity_manager;
+  uint32_t *entity_ids; // Entity index -> order in which it's written
 } eg_serializer_t;
 
 void eg_serializer_init(eg_serializer_t *serializer);
@@ -33,3 +37,7 @@ void eg_serializer_append_string(eg_serializer_t *serializer, char *string);
 void eg_serializer_append_u32(eg_serializer_t *serializer, uint32_t data);
 
 void eg_serializer_append_u64(eg_serializer_t *serializer, uint64_t data);
+
+// Writes a reference to another entity of the scene being serialized
+void eg_serializer_append_entity(
+    eg_serializer_t *serializer, eg_entity_t entity);
@@ -0,0 +1,146 @@
+#include "system_registry.h"
+
+#include "util.h"
+#include <assert.h>
+#include <string.h>
+
+_Static_assert(
+    EG_COMP_TYPE_MAX + EG_SYSTEM_RESOURCE_MAX <= 64,
+    "access masks must fit in 64 bits");
+
+static inline bool systems_conflict(eg_system_t *a, eg_system_t *b) {
+  return (a->desc.writes & (b->desc.reads | b->desc.writes)) ||
+         (b->desc.writes & a->desc.reads);
+}
+
+static void build_graph(eg_system_registry_t *registry) {
+  for (uint32_t i = 0; i < registry->system_count; i++) {
+    registry->systems[i].successors = 0;
+    registry->systems[i].pending    = 0;
+  }
+
+  // Conflicting systems run in registration order
+  for (uint32_t i = 0; i < registry->system_count; i++) {
+    eg_system_t *system = &registry->systems[i];
+
+    for (uint32_t j = 0; j < i; j++) {
+      if (systems_conflict(&registry->systems[j], system)) {
+        registry->systems[j].successors |= (uint64_t)1 << i;
+        system->pending++;
+      }
+    }
+  }
+}
+
+static int system_task(void *args);
+
+// Called with the registry's mutex locked
+static void dispatch_system(
+    eg_system_registry_t *registry,
+    eg_task_scheduler_t *scheduler,
+    uint32_t index) {
+  eg_system_t *system = &registry->systems[index];
+
+  if (system->desc.main_thread || scheduler == NULL ||
+      scheduler->num_workers == 0) {
+    registry->main_ready |= (uint64_t)1 << index;
+    cnd_signal(&registry->cond);
+  } else {
+    eg_scheduler_add_task(scheduler, system_task, system);
+  }
+}
+
+// Called with the registry's mutex locked
+static void finish_system(
+    eg_system_registry_t *registry,
+    eg_task_scheduler_t *scheduler,
+    uint32_t index) {
+  uint64_t successors = registry->systems[index].successors;
+
+  while (successors != 0) {
+    uint32_t s = eg_ctz64(successors);
+    successors &= successors - 1;
+
+    if (--registry->systems[s].pending == 0) {
+      dispatch_system(registry, scheduler, s);
+    }
+  }
+
+  if (--registry->remaining == 0) {
+    cnd_signal(&registry->cond);
+  }
+}
+
+static int system_task(void *args) {
+  eg_system_t *system             = args;
+  eg_system_registry_t *registry = system->registry;
+
+  system->desc.run(system->desc.userdata);
+
+  mtx_lock(&registry->mutex);
+  finish_system(
+      registry, registry->scheduler, (uint32_t)(system - registry->systems));
+  mtx_unlock(&registry->mutex);
+
+  return 0;
+}
+
+void eg_system_registry_init(eg_system_registry_t *registry) {
+  memset(registry, 0, sizeof(*registry));
+
+  mtx_init(&registry->mutex, mtx_plain);
+  cnd_init(&registry->cond);
+}
+
+void eg_system_registry_destroy(eg_system_registry_t *registry) {
+  cnd_destroy(&registry->cond);
+  mtx_destroy(&registry->mutex);
+}
+
+void eg_system_registry_add(
+    eg_system_registry_t *registry, const eg_system_desc_t *desc) {
+  assert(registry->system_count < EG_MAX_SYSTEMS);
+
+  eg_system_t *system = &registry->systems[registry->system_count++];
+  system->desc        = *desc;
+  system->registry    = registry;
+}
+
+void eg_system_registry_run(
+    eg_system_registry_t *registry, eg_task_scheduler_t *scheduler) {
+  if (registry->system_count == 0) return;
+
+  mtx_lock(&registry->mutex);
+
+  build_graph(registry);
+
+  registry->scheduler  = scheduler;
+  registry->main_ready = 0;
+  registry->remaining  = registry->system_count;
+
+  for (uint32_t i = 0; i < registry->system_count; i++) {
+    if (registry->systems[i].pending == 0) {
+      dispatch_system(registry, scheduler, i);
+    }
+  }
+
+  // Run the main thread systems as they become ready, and sleep while the
+  // workers run the rest
+  while (registry->remaining > 0) {
+    if (registry->main_ready == 0) {
+      cnd_wait(&registry->cond, &registry->mutex);
+      continue;
+    }
+
+    uint32_t index = eg_ctz64(registry->main_ready);
+    registry->main_ready &= registry->main_ready - 1;
+
+    mtx_unlock(&registry->mutex);
+    registry->systems[index].desc.run(registry->systems[index].desc.userdata);
+    mtx_lock(&registry->mutex);
+
+    finish_system(registry, scheduler, index);
+  }
+
+  mtx_unlock(&registry->mutex);
+}
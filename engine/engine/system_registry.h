@@ -0,0 +1,82 @@
+#pragma once
+
+#include "comps/comp_types.h"
+#include "task_scheduler.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Runs a set of systems every frame, in parallel where possible. Each system
+ * declares which component types (and which shared engine resources) it reads
+ * and writes. Two systems conflict when one of them writes something the other
+ * one reads or writes, and conflicting systems run in the order they were
+ * registered. Systems that don't conflict run concurrently on the task
+ * scheduler's workers.
+ *
+ * Structural changes (adding/removing entities and components) must go through
+ * an eg_ecs_cmd_buffer_t while the systems are running.
+ */
+
+#define EG_MAX_SYSTEMS 64
+
+// Shared state that isn't stored in components
+typedef enum eg_system_resource_t {
+  EG_SYSTEM_RESOURCE_CAMERA,
+  EG_SYSTEM_RESOURCE_ENVIRONMENT,
+  EG_SYSTEM_RESOURCE_WORLD_MATRICES, // eg_transform_system_t's cache
+  EG_SYSTEM_RESOURCE_MAX,
+} eg_system_resource_t;
+
+// Access masks have one bit per component type followed by one bit per
+// resource
+typedef uint64_t eg_system_access_t;
+
+#define EG_ACCESS_COMP(comp) ((eg_system_access_t)1 << EG_COMP_TYPE(comp))
+#define EG_ACCESS_RESOURCE(resource)                                           \
+  ((eg_system_access_t)1 << (EG_COMP_TYPE_MAX + (resource)))
+
+typedef void (*eg_system_fn_t)(void *userdata);
+
+typedef struct eg_system_desc_t {
+  const char *name;
+  eg_system_fn_t run;
+  void *userdata;
+  eg_system_access_t reads;
+  eg_system_access_t writes;
+  // Runs on the thread that calls eg_system_registry_run (for systems that
+  // record GPU commands or read window input)
+  bool main_thread;
+} eg_system_desc_t;
+
+typedef struct eg_system_t {
+  eg_system_desc_t desc;
+  struct eg_system_registry_t *registry;
+
+  // Dependency graph, rebuilt every frame
+  uint64_t successors; // Bit per system
+  uint32_t pending;    // Dependencies that haven't finished yet
+} eg_system_t;
+
+typedef struct eg_system_registry_t {
+  eg_system_t systems[EG_MAX_SYSTEMS];
+  uint32_t system_count;
+
+  // State of the current run
+  eg_task_scheduler_t *scheduler;
+  mtx_t mutex;
+  cnd_t cond;
+  uint64_t main_ready; // Main thread systems ready to run
+  uint32_t remaining;  // Systems that haven't finished this frame
+} eg_system_registry_t;
+
+void eg_system_registry_init(eg_system_registry_t *registry);
+
+void eg_system_registry_destroy(eg_system_registry_t *registry);
+
+void eg_system_registry_add(
+    eg_system_registry_t *registry, const eg_system_desc_t *desc);
+
+// Runs every registered system once and waits for all of them to finish.
+// With a NULL scheduler all the systems run on the calling thread.
+void eg_system_registry_run(
+    eg_system_registry_t *registry, eg_task_scheduler_t *scheduler);
@@ -8,24 +8,28 @@
 void eg_light_system(eg_scene_t *scene) {
   eg_entity_manager_t *entity_manager = &scene->entity_manager;
 
-  eg_transform_comp_t *transforms =
-      EG_COMP_ARRAY(entity_manager, eg_transform_comp_t);
-  eg_point_light_comp_t *point_lights =
-      EG_COMP_ARRAY(entity_manager, eg_point_light_comp_t);
-
   eg_environment_reset_point_lights(&scene->environment);
 
-  for (eg_entity_t e = 0; e < entity_manager->entity_max; e++) {
-    if (EG_HAS_TAG(entity_manager, e, EG_TAG_HIDDEN)) {
+  // Point lights use sparse set storage, so only the entities that have one
+  // are visited
+  uint32_t light_count = EG_COMP_COUNT(entity_manager, eg_point_light_comp_t);
+
+  for (uint32_t i = 0; i < light_count; i++) {
+    eg_entity_t e =
+        EG_COMP_DENSE_ENTITY(entity_manager, eg_point_light_comp_t, i);
+
+    if (!EG_HAS_COMP(entity_manager, e, eg_transform_comp_t) ||
+        EG_HAS_TAG(entity_manager, e, EG_TAG_HIDDEN)) {
       continue;
     }
 
-    if (EG_HAS_COMP(entity_manager, e, eg_point_light_comp_t) &&
-        EG_HAS_COMP(entity_manager, e, eg_transform_comp_t)) {
-      eg_environment_add_point_light(
-          &scene->environment,
-          transforms[e].position,
-          vec4_muls(point_lights[e].color, point_lights[e].intensity));
-    }
+    mat4_t world = eg_transform_system_world(&scene->transform_system, e);
+    eg_point_light_comp_t *point_light =
+        EG_COMP_DENSE(entity_manager, eg_point_light_comp_t, i);
+
+    eg_environment_add_point_light(
+        &scene->environment,
+        world.v[3].xyz,
+        vec4_muls(point_light->color, point_light->intensity));
   }
 }
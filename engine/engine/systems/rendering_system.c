@@ -23,30 +23,20 @@ void eg_rendering_system(eg_scene_t *scene, re_cmd_buffer_t *cmd_buffer) {
 
   re_pipeline_t *pipeline = NULL;
 
-  eg_transform_comp_t *transforms =
-      EG_COMP_ARRAY(entity_manager, eg_transform_comp_t);
-  eg_renderable_comp_t *renderables =
-      EG_COMP_ARRAY(entity_manager, eg_renderable_comp_t);
-  eg_mesh_comp_t *meshes      = EG_COMP_ARRAY(entity_manager, eg_mesh_comp_t);
-  eg_gltf_comp_t *gltf_models = EG_COMP_ARRAY(entity_manager, eg_gltf_comp_t);
+  eg_query_iter_t iter = eg_query_iter(
+      entity_manager,
+      &(eg_query_t){
+          .all_comps = EG_COMP_BIT(eg_renderable_comp_t),
+          .none_tags = EG_TAG_BIT(EG_TAG_HIDDEN),
+      });
 
   // Draw all meshes
-  for (eg_entity_t e = 0; e < entity_manager->entity_max; e++) {
-    if (!eg_entity_exists(entity_manager, e)) {
-      continue;
-    }
-
-    if (EG_HAS_TAG(entity_manager, e, EG_TAG_HIDDEN)) {
-      continue;
-    }
-
-    if (!EG_HAS_COMP(entity_manager, e, eg_renderable_comp_t)) {
-      continue;
-    }
-
+  eg_entity_t e;
+  while (eg_query_next(&iter, &e)) {
     // Bind pipeline
     re_pipeline_t *renderable_pipeline =
-        eg_renderable_comp_get_pipeline(&renderables[e]);
+        eg_renderable_comp_get_pipeline(
+            EG_COMP(entity_manager, e, eg_renderable_comp_t));
 
     if (renderable_pipeline == NULL) {
       continue;
@@ -72,19 +62,19 @@ void eg_rendering_system(eg_scene_t *scene, re_cmd_buffer_t *cmd_buffer) {
       }
 
       eg_mesh_comp_draw(
-          &meshes[e],
+          EG_COMP(entity_manager, e, eg_mesh_comp_t),
           cmd_buffer,
           pipeline,
-          eg_transform_comp_mat4(&transforms[e]));
+          eg_transform_system_world(&scene->transform_system, e));
     }
 
     if (EG_HAS_COMP(entity_manager, e, eg_gltf_comp_t) &&
         EG_HAS_COMP(entity_manager, e, eg_transform_comp_t)) {
       eg_gltf_comp_draw(
-          &gltf_models[e],
+          EG_COMP(entity_manager, e, eg_gltf_comp_t),
           cmd_buffer,
           pipeline,
-          eg_transform_comp_mat4(&transforms[e]));
+          eg_transform_system_world(&scene->transform_system, e));
     }
   }
 }
@@ -0,0 +1,546 @@
+#include "transform_system.h"
+
+#include "../comps/hierarchy_comp.h"
+#include "../comps/transform_comp.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+#define SOA_ARRAY_COUNT 10
+
+// Returns the SoA arrays in a flat list, in no particular order
+static inline float **soa_arrays(eg_transform_soa_t *soa) {
+  _Static_assert(
+      sizeof(eg_transform_soa_t) == SOA_ARRAY_COUNT * sizeof(float *),
+      "eg_transform_soa_t should only contain float arrays");
+  return (float **)soa;
+}
+
+static void reserve(eg_transform_system_t *system, uint32_t count) {
+  if (count <= system->cap) return;
+
+  uint32_t new_cap = system->cap == 0 ? EG_ENTITY_CHUNK_SIZE : system->cap;
+  while (new_cap < count) {
+    new_cap *= 2;
+  }
+
+  float **arrays = soa_arrays(&system->soa);
+  for (uint32_t i = 0; i < SOA_ARRAY_COUNT; i++) {
+    arrays[i] = realloc(arrays[i], new_cap * sizeof(float));
+  }
+
+  system->indices =
+      realloc(system->indices, new_cap * sizeof(*system->indices));
+
+  system->cap = new_cap;
+}
+
+static void reserve_world(eg_transform_system_t *system, uint32_t count) {
+  if (count <= system->world_cap) return;
+
+  system->local = realloc(system->local, count * sizeof(*system->local));
+  system->world = realloc(system->world, count * sizeof(*system->world));
+  for (uint32_t i = system->world_cap; i < count; i++) {
+    system->local[i] = mat4_identity();
+    system->world[i] = mat4_identity();
+  }
+
+  uint32_t old_words = EG_BITSET_WORDS(system->world_cap);
+  uint32_t new_words = EG_BITSET_WORDS(count);
+  system->changed =
+      realloc(system->changed, new_words * sizeof(*system->changed));
+  memset(
+      &system->changed[old_words],
+      0,
+      (new_words - old_words) * sizeof(*system->changed));
+
+  system->world_cap = count;
+}
+
+static int compare_nodes(const void *a, const void *b) {
+  const eg_transform_node_t *node_a = a;
+  const eg_transform_node_t *node_b = b;
+  if (node_a->depth != node_b->depth) {
+    return node_a->depth < node_b->depth ? -1 : 1;
+  }
+  // Keep the order stable for nodes with the same depth
+  return node_a->index < node_b->index ? -1 : (node_a->index > node_b->index);
+}
+
+// Returns the parent of `entity` if it has one that takes part in the
+// hierarchy, EG_NULL_ENTITY otherwise
+static eg_entity_t
+get_parent(eg_entity_manager_t *entity_manager, eg_entity_t entity) {
+  if (!EG_HAS_COMP(entity_manager, entity, eg_hierarchy_comp_t)) {
+    return EG_NULL_ENTITY;
+  }
+
+  eg_entity_t parent =
+      EG_COMP(entity_manager, entity, eg_hierarchy_comp_t)->parent;
+  if (!eg_entity_exists(entity_manager, parent) ||
+      !EG_HAS_COMP(entity_manager, parent, eg_transform_comp_t)) {
+    return EG_NULL_ENTITY;
+  }
+
+  return parent;
+}
+
+/*
+ * Re-sorts the hierarchy nodes if a hierarchy component was added, removed or
+ * re-parented since the last update. Entities whose parent changed get their
+ * world matrix rebuilt, and the ones that left the hierarchy go back to their
+ * local matrix.
+ */
+static void sort_nodes(
+    eg_transform_system_t *system, eg_entity_manager_t *entity_manager) {
+  uint32_t hierarchy_count =
+      EG_COMP_COUNT(entity_manager, eg_hierarchy_comp_t);
+
+  bool needs_sort      = false;
+  uint32_t node_count = 0;
+
+  for (uint32_t i = 0; i < hierarchy_count; i++) {
+    eg_entity_t e =
+        EG_COMP_DENSE_ENTITY(entity_manager, eg_hierarchy_comp_t, i);
+    eg_hierarchy_comp_t *hierarchy =
+        EG_COMP_DENSE(entity_manager, eg_hierarchy_comp_t, i);
+
+    if (!EG_HAS_COMP(entity_manager, e, eg_transform_comp_t)) continue;
+
+    node_count++;
+
+    if (hierarchy->dirty) {
+      hierarchy->dirty = false;
+      needs_sort       = true;
+      EG_BITSET_SET(system->changed, EG_ENTITY_INDEX(e));
+    }
+  }
+
+  if (!needs_sort && node_count == system->node_count) {
+    return;
+  }
+
+  if (node_count > system->node_cap) {
+    system->node_cap = node_count;
+    system->nodes =
+        realloc(system->nodes, system->node_cap * sizeof(*system->nodes));
+  }
+
+  // Only dirty transforms are rebuilt outside of the hierarchy, so an entity
+  // that loses its hierarchy component would keep the matrix that included
+  // its old parent
+  for (uint32_t i = 0; i < system->node_count; i++) {
+    uint32_t index = system->nodes[i].index;
+    eg_entity_t e  = eg_entity_from_index(entity_manager, index);
+
+    if (e != EG_NULL_ENTITY &&
+        !EG_HAS_COMP(entity_manager, e, eg_hierarchy_comp_t)) {
+      system->world[index] = system->local[index];
+    }
+  }
+
+  system->node_count = 0;
+
+  for (uint32_t i = 0; i < hierarchy_count; i++) {
+    eg_entity_t e =
+        EG_COMP_DENSE_ENTITY(entity_manager, eg_hierarchy_comp_t, i);
+
+    if (!EG_HAS_COMP(entity_manager, e, eg_transform_comp_t)) continue;
+
+    // Walk up to the root. Cycles are cut off after visiting every node.
+    uint32_t depth = 0;
+    for (eg_entity_t parent = get_parent(entity_manager, e);
+         parent != EG_NULL_ENTITY && depth < node_count;
+         parent = get_parent(entity_manager, parent)) {
+      depth++;
+    }
+
+    system->nodes[system->node_count++] = (eg_transform_node_t){
+        .index = EG_ENTITY_INDEX(e),
+        .depth = depth,
+    };
+  }
+
+  qsort(
+      system->nodes,
+      system->node_count,
+      sizeof(*system->nodes),
+      compare_nodes);
+}
+
+void eg_transform_system_init(eg_transform_system_t *system) {
+  memset(system, 0, sizeof(*system));
+}
+
+void eg_transform_system_destroy(eg_transform_system_t *system) {
+  float **arrays = soa_arrays(&system->soa);
+  for (uint32_t i = 0; i < SOA_ARRAY_COUNT; i++) {
+    free(arrays[i]);
+  }
+
+  free(system->indices);
+  free(system->local);
+  free(system->world);
+  free(system->changed);
+  free(system->nodes);
+}
+
+void eg_transform_system_update(
+    eg_transform_system_t *system, eg_entity_manager_t *entity_manager) {
+  reserve_world(system, entity_manager->entity_cap);
+
+  eg_query_iter_t iter = eg_query_iter(
+      entity_manager,
+      &(eg_query_t){
+          .all_comps = EG_COMP_BIT(eg_transform_comp_t),
+      });
+
+  // Gather the dirty transforms into the SoA arrays
+  eg_transform_soa_t *soa = &system->soa;
+
+  system->count           = 0;
+  system->transform_count = 0;
+
+  eg_entity_t e;
+  while (eg_query_next(&iter, &e)) {
+    system->transform_count++;
+
+    eg_transform_comp_t *transform =
+        EG_COMP(entity_manager, e, eg_transform_comp_t);
+
+    if (!transform->dirty) continue;
+    transform->dirty = false;
+
+    reserve(system, system->count + 1);
+
+    uint32_t i = system->count++;
+
+    soa->position[0][i] = transform->position.x;
+    soa->position[1][i] = transform->position.y;
+    soa->position[2][i] = transform->position.z;
+    soa->axis[0][i]     = transform->axis.x;
+    soa->axis[1][i]     = transform->axis.y;
+    soa->axis[2][i]     = transform->axis.z;
+    soa->angle[i]       = transform->angle;
+    soa->scale[0][i]    = transform->scale.x;
+    soa->scale[1][i]    = transform->scale.y;
+    soa->scale[2][i]    = transform->scale.z;
+
+    system->indices[i] = EG_ENTITY_INDEX(e);
+  }
+
+  eg_transform_batch(soa, system->indices, system->count, system->local);
+
+  for (uint32_t i = 0; i < system->count; i++) {
+    EG_BITSET_SET(system->changed, system->indices[i]);
+  }
+
+  sort_nodes(system, entity_manager);
+
+  system->recompute_count = 0;
+
+  // Entities outside of the hierarchy: the world matrix is the local one
+  for (uint32_t i = 0; i < system->count; i++) {
+    uint32_t index = system->indices[i];
+
+    if (!EG_HAS_COMP(entity_manager, index, eg_hierarchy_comp_t)) {
+      system->world[index] = system->local[index];
+      system->recompute_count++;
+    }
+  }
+
+  // Entities with a parent, in one pass since parents come first. Only the
+  // subtrees that have something changed get updated.
+  for (uint32_t i = 0; i < system->node_count; i++) {
+    uint32_t index     = system->nodes[i].index;
+    eg_entity_t entity = eg_entity_from_index(entity_manager, index);
+
+    // Removed since the nodes were sorted
+    if (entity == EG_NULL_ENTITY ||
+        !EG_HAS_COMP(entity_manager, entity, eg_hierarchy_comp_t) ||
+        !EG_HAS_COMP(entity_manager, entity, eg_transform_comp_t)) {
+      continue;
+    }
+
+    eg_entity_t parent = get_parent(entity_manager, entity);
+
+    if (parent == EG_NULL_ENTITY) {
+      eg_hierarchy_comp_t *hierarchy =
+          EG_COMP(entity_manager, entity, eg_hierarchy_comp_t);
+      if (hierarchy->parent != EG_NULL_ENTITY &&
+          !eg_entity_exists(entity_manager, hierarchy->parent)) {
+        // The parent was removed: detach and keep the local transform.
+        // Removing an edge keeps the order valid, so no need to re-sort.
+        hierarchy->parent = EG_NULL_ENTITY;
+        EG_BITSET_SET(system->changed, index);
+      }
+
+      if (EG_BITSET_AT(system->changed, index)) {
+        system->world[index] = system->local[index];
+        system->recompute_count++;
+      }
+      continue;
+    }
+
+    uint32_t parent_index = EG_ENTITY_INDEX(parent);
+    if (EG_BITSET_AT(system->changed, index) ||
+        EG_BITSET_AT(system->changed, parent_index)) {
+      system->world[index] =
+          mat4_mul(system->local[index], system->world[parent_index]);
+      EG_BITSET_SET(system->changed, index);
+      system->recompute_count++;
+    }
+  }
+
+  // Reset the changed bits for the next update
+  for (uint32_t i = 0; i < system->count; i++) {
+    EG_BITSET_CLEAR(system->changed, system->indices[i]);
+  }
+  for (uint32_t i = 0; i < system->node_count; i++) {
+    EG_BITSET_CLEAR(system->changed, system->nodes[i].index);
+  }
+}
+
+/*
+ * Builds the same matrix as eg_transform_comp_mat4 (translation * rotation *
+ * scale) without going through the full matrix multiplications
+ */
+static inline void build_world(
+    const eg_transform_soa_t *soa, uint32_t i, mat4_t *world) {
+  float ax = soa->axis[0][i];
+  float ay = soa->axis[1][i];
+  float az = soa->axis[2][i];
+
+  float norm = sqrtf(ax * ax + ay * ay + az * az);
+  if (norm != 0.0f) {
+    ax /= norm;
+    ay /= norm;
+    az /= norm;
+  }
+
+  float c = cosf(soa->angle[i]);
+  float s = sinf(soa->angle[i]);
+
+  float tx = ax * (1.0f - c);
+  float ty = ay * (1.0f - c);
+  float tz = az * (1.0f - c);
+
+  float sx = soa->scale[0][i];
+  float sy = soa->scale[1][i];
+  float sz = soa->scale[2][i];
+
+  *world = (mat4_t){{
+      {(c + tx * ax) * sx, (tx * ay + s * az) * sx, (tx * az - s * ay) * sx, 0},
+      {(ty * ax - s * az) * sy, (c + ty * ay) * sy, (ty * az + s * ax) * sy, 0},
+      {(tz * ax + s * ay) * sz, (tz * ay - s * ax) * sz, (c + tz * az) * sz, 0},
+      {soa->position[0][i], soa->position[1][i], soa->position[2][i], 1},
+  }};
+}
+
+void eg_transform_batch_scalar(
+    const eg_transform_soa_t *soa,
+    const uint32_t *indices,
+    uint32_t count,
+    mat4_t *world) {
+  for (uint32_t i = 0; i < count; i++) {
+    build_world(soa, i, &world[indices[i]]);
+  }
+}
+
+#ifdef __AVX__
+
+static inline __m256 madd8(__m256 a, __m256 b, __m256 c) {
+  return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+}
+
+/*
+ * Sine and cosine of 8 floats (Cephes sinf/cosf polynomials). The argument is
+ * reduced to [-pi/4, pi/4] with an extended precision pi/2, and the quadrant
+ * picks which polynomial goes where and with which sign. This only uses AVX
+ * float instructions, since 256-bit integer operations need AVX2.
+ */
+static inline void sincos8(__m256 x, __m256 *out_sin, __m256 *out_cos) {
+  const __m256 one      = _mm256_set1_ps(1.0f);
+  const __m256 sign_bit = _mm256_set1_ps(-0.0f);
+
+  __m256 j = _mm256_round_ps(
+      _mm256_mul_ps(x, _mm256_set1_ps(0.63661977236758134f)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+
+  __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(j, _mm256_set1_ps(1.5703125f)));
+  r = _mm256_sub_ps(
+      r, _mm256_mul_ps(j, _mm256_set1_ps(4.837512969970703125e-4f)));
+  r = _mm256_sub_ps(
+      r, _mm256_mul_ps(j, _mm256_set1_ps(7.54978995489188216e-8f)));
+
+  // Quadrant: j mod 4
+  __m256 q = _mm256_sub_ps(
+      j,
+      _mm256_mul_ps(
+          _mm256_floor_ps(_mm256_mul_ps(j, _mm256_set1_ps(0.25f))),
+          _mm256_set1_ps(4.0f)));
+
+  __m256 z = _mm256_mul_ps(r, r);
+
+  __m256 sin_p = madd8(
+      madd8(
+          _mm256_set1_ps(-1.9515295891e-4f),
+          z,
+          _mm256_set1_ps(8.3321608736e-3f)),
+      z,
+      _mm256_set1_ps(-1.6666654611e-1f));
+  __m256 sin_r = madd8(_mm256_mul_ps(sin_p, z), r, r);
+
+  __m256 cos_p = madd8(
+      madd8(
+          _mm256_set1_ps(2.443315711809948e-5f),
+          z,
+          _mm256_set1_ps(-1.388731625493765e-3f)),
+      z,
+      _mm256_set1_ps(4.166664568298827e-2f));
+  __m256 cos_r = madd8(
+      _mm256_mul_ps(cos_p, z), z, madd8(_mm256_set1_ps(-0.5f), z, one));
+
+  __m256 q1 = _mm256_cmp_ps(q, one, _CMP_EQ_OQ);
+  __m256 q2 = _mm256_cmp_ps(q, _mm256_set1_ps(2.0f), _CMP_EQ_OQ);
+  __m256 q3 = _mm256_cmp_ps(q, _mm256_set1_ps(3.0f), _CMP_EQ_OQ);
+
+  // Odd quadrants swap sine and cosine
+  __m256 swap = _mm256_or_ps(q1, q3);
+  __m256 s    = _mm256_blendv_ps(sin_r, cos_r, swap);
+  __m256 c    = _mm256_blendv_ps(cos_r, sin_r, swap);
+
+  s = _mm256_xor_ps(s, _mm256_and_ps(_mm256_or_ps(q2, q3), sign_bit));
+  c = _mm256_xor_ps(c, _mm256_and_ps(_mm256_or_ps(q1, q2), sign_bit));
+
+  *out_sin = s;
+  *out_cos = c;
+}
+
+// Turns 8 rows of 8 lanes into 8 rows with one lane each
+static inline void transpose8(__m256 rows[8]) {
+  __m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+  __m256 t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+  __m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]);
+  __m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+  __m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]);
+  __m256 t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+  __m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]);
+  __m256 t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+
+  __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+  rows[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+  rows[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+  rows[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+  rows[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+  rows[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+  rows[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+  rows[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+  rows[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+// Builds the world matrices of transforms [i, i + 8)
+static inline void build_world8(
+    const eg_transform_soa_t *soa,
+    const uint32_t *indices,
+    uint32_t i,
+    mat4_t *world) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one  = _mm256_set1_ps(1.0f);
+
+  __m256 ax = _mm256_loadu_ps(&soa->axis[0][i]);
+  __m256 ay = _mm256_loadu_ps(&soa->axis[1][i]);
+  __m256 az = _mm256_loadu_ps(&soa->axis[2][i]);
+
+  // Normalize the axis, leaving zero axes alone like vec3_normalize does
+  __m256 norm2 = _mm256_add_ps(
+      _mm256_add_ps(_mm256_mul_ps(ax, ax), _mm256_mul_ps(ay, ay)),
+      _mm256_mul_ps(az, az));
+  __m256 nonzero = _mm256_cmp_ps(norm2, zero, _CMP_NEQ_OQ);
+  __m256 inv_norm = _mm256_blendv_ps(
+      one, _mm256_div_ps(one, _mm256_sqrt_ps(norm2)), nonzero);
+  ax = _mm256_mul_ps(ax, inv_norm);
+  ay = _mm256_mul_ps(ay, inv_norm);
+  az = _mm256_mul_ps(az, inv_norm);
+
+  __m256 s, c;
+  sincos8(_mm256_loadu_ps(&soa->angle[i]), &s, &c);
+
+  __m256 one_c = _mm256_sub_ps(one, c);
+  __m256 tx    = _mm256_mul_ps(ax, one_c);
+  __m256 ty    = _mm256_mul_ps(ay, one_c);
+  __m256 tz    = _mm256_mul_ps(az, one_c);
+
+  __m256 sx = _mm256_loadu_ps(&soa->scale[0][i]);
+  __m256 sy = _mm256_loadu_ps(&soa->scale[1][i]);
+  __m256 sz = _mm256_loadu_ps(&soa->scale[2][i]);
+
+  __m256 sax = _mm256_mul_ps(s, ax);
+  __m256 say = _mm256_mul_ps(s, ay);
+  __m256 saz = _mm256_mul_ps(s, az);
+
+  // First half of the matrices: columns 0 and 1
+  __m256 lo[8] = {
+      _mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(tx, ax)), sx),
+      _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(tx, ay), saz), sx),
+      _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(tx, az), say), sx),
+      zero,
+      _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(ty, ax), saz), sy),
+      _mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(ty, ay)), sy),
+      _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ty, az), sax), sy),
+      zero,
+  };
+
+  // Second half of the matrices: column 2 and the translation
+  __m256 hi[8] = {
+      _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(tz, ax), say), sz),
+      _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(tz, ay), sax), sz),
+      _mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(tz, az)), sz),
+      zero,
+      _mm256_loadu_ps(&soa->position[0][i]),
+      _mm256_loadu_ps(&soa->position[1][i]),
+      _mm256_loadu_ps(&soa->position[2][i]),
+      one,
+  };
+
+  transpose8(lo);
+  transpose8(hi);
+
+  for (uint32_t k = 0; k < 8; k++) {
+    mat4_t *mat = &world[indices[i + k]];
+    _mm256_storeu_ps(&mat->elems[0], lo[k]);
+    _mm256_storeu_ps(&mat->elems[8], hi[k]);
+  }
+}
+
+#endif
+
+void eg_transform_batch(
+    const eg_transform_soa_t *soa,
+    const uint32_t *indices,
+    uint32_t count,
+    mat4_t *world) {
+  uint32_t i = 0;
+
+#ifdef __AVX__
+  for (; i + 8 <= count; i += 8) {
+    build_world8(soa, indices, i, world);
+  }
+#endif
+
+  // Remaining transforms
+  for (; i < count; i++) {
+    build_world(soa, i, &world[indices[i]]);
+  }
+}
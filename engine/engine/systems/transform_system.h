@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../entity_manager.h"
+#include <assert.h>
+#include <gmath.h>
+
+/*
+ * Structure-of-arrays copy of the fields of eg_transform_comp_t, so that the
+ * world matrices can be built for several entities at once with SIMD
+ */
+typedef struct eg_transform_soa_t {
+  float *position[3];
+  float *axis[3];
+  float *angle;
+  float *scale[3];
+} eg_transform_soa_t;
+
+typedef struct eg_transform_node_t {
+  uint32_t index; // Entity index
+  uint32_t depth; // Amount of ancestors
+} eg_transform_node_t;
+
+typedef struct eg_transform_system_t {
+  eg_transform_soa_t soa;
+  uint32_t *indices; // Entity index of each element in `soa`
+  uint32_t count;
+  uint32_t cap;
+
+  // Matrices indexed by entity index. The local matrix only depends on the
+  // entity's own transform, the world matrix also includes its parents.
+  mat4_t *local;
+  mat4_t *world;
+  uint64_t *changed; // World matrices changed in the current update
+  uint32_t world_cap;
+
+  // Entities with a hierarchy component, sorted by depth so that parents are
+  // always updated before their children
+  eg_transform_node_t *nodes;
+  uint32_t node_count;
+  uint32_t node_cap;
+
+  // Statistics of the last update
+  uint32_t transform_count; // Entities with a transform
+  uint32_t recompute_count; // World matrices that were rebuilt
+} eg_transform_system_t;
+
+void eg_transform_system_init(eg_transform_system_t *system);
+
+void eg_transform_system_destroy(eg_transform_system_t *system);
+
+/*
+ * Rebuilds the world matrices of the transforms marked as dirty and of their
+ * descendants (see eg_hierarchy_comp_t), the others keep the matrix from the
+ * previous update
+ */
+void eg_transform_system_update(
+    eg_transform_system_t *system, eg_entity_manager_t *entity_manager);
+
+// World matrix of `entity` as of the last eg_transform_system_update
+static inline mat4_t
+eg_transform_system_world(eg_transform_system_t *system, eg_entity_t entity) {
+  assert(EG_ENTITY_INDEX(entity) < system->world_cap);
+  return system->world[EG_ENTITY_INDEX(entity)];
+}
+
+/*
+ * Batch kernels: build the world matrices of the first `count` transforms in
+ * `soa`, storing the i-th one in world[indices[i]]. eg_transform_batch uses
+ * AVX when it's available and falls back to the scalar kernel otherwise.
+ */
+void eg_transform_batch_scalar(
+    const eg_transform_soa_t *soa,
+    const uint32_t *indices,
+    uint32_t count,
+    mat4_t *world);
+
+void eg_transform_batch(
+    const eg_transform_soa_t *soa,
+    const uint32_t *indices,
+    uint32_t count,
+    mat4_t *world);
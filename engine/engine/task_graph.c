@@ -0,0 +1,200 @@
+#include "task_graph.h"
+
+#include "util.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_NODE_CAP 16
+#define INITIAL_SUCCESSOR_CAP 4
+
+void eg_task_graph_init(eg_task_graph_t *graph) {
+  memset(graph, 0, sizeof(*graph));
+  eg_task_group_init(&graph->group);
+}
+
+void eg_task_graph_destroy(eg_task_graph_t *graph) {
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    free(graph->nodes[i].successors);
+  }
+
+  free(graph->nodes);
+}
+
+eg_task_node_t eg_task_graph_add_node(
+    eg_task_graph_t *graph,
+    const char *name,
+    thrd_start_t routine,
+    void *args) {
+  if (graph->node_count >= graph->node_cap) {
+    graph->node_cap =
+        graph->node_cap == 0 ? INITIAL_NODE_CAP : graph->node_cap * 2;
+    graph->nodes =
+        realloc(graph->nodes, graph->node_cap * sizeof(*graph->nodes));
+  }
+
+  eg_task_graph_node_t *node = &graph->nodes[graph->node_count];
+  memset(node, 0, sizeof(*node));
+  node->name    = name;
+  node->routine = routine;
+  node->args    = args;
+  atomic_init(&node->pending, 0);
+
+  return graph->node_count++;
+}
+
+#ifndef NDEBUG
+// Whether `target` can be reached by following edges from `node`. Each node is
+// visited once, so diamond shaped graphs stay linear, and the walk uses its
+// own stack instead of recursing.
+static bool
+reaches(eg_task_graph_t *graph, eg_task_node_t node, eg_task_node_t target) {
+  if (node == target) return true;
+  // Edges usually point to nodes that don't have successors yet
+  if (graph->nodes[node].successor_count == 0) return false;
+
+  uint32_t word_count   = (graph->node_count + 63) / 64;
+  uint64_t *visited     = calloc(word_count, sizeof(*visited));
+  eg_task_node_t *stack = malloc(graph->node_count * sizeof(*stack));
+  uint32_t stack_count  = 0;
+
+  visited[node / 64] |= 1ULL << (node % 64);
+  stack[stack_count++] = node;
+
+  bool found = false;
+  while (stack_count > 0) {
+    eg_task_node_t current = stack[--stack_count];
+    if (current == target) {
+      found = true;
+      break;
+    }
+
+    eg_task_graph_node_t *n = &graph->nodes[current];
+    for (uint32_t i = 0; i < n->successor_count; i++) {
+      eg_task_node_t successor = n->successors[i];
+      if (visited[successor / 64] & (1ULL << (successor % 64))) continue;
+      visited[successor / 64] |= 1ULL << (successor % 64);
+      stack[stack_count++] = successor;
+    }
+  }
+
+  free(stack);
+  free(visited);
+
+  return found;
+}
+#endif
+
+void eg_task_graph_add_edge(
+    eg_task_graph_t *graph, eg_task_node_t from, eg_task_node_t to) {
+  assert(from < graph->node_count && to < graph->node_count);
+  assert(!reaches(graph, to, from) && "edge would create a cycle");
+
+  eg_task_graph_node_t *node = &graph->nodes[from];
+
+  if (node->successor_count >= node->successor_cap) {
+    node->successor_cap = node->successor_cap == 0 ? INITIAL_SUCCESSOR_CAP
+                                                   : node->successor_cap * 2;
+    node->successors    = realloc(
+        node->successors, node->successor_cap * sizeof(*node->successors));
+  }
+
+  node->successors[node->successor_count++] = to;
+  graph->nodes[to].predecessor_count++;
+}
+
+static int node_task(void *args) {
+  eg_task_graph_node_t *node = args;
+  eg_task_graph_t *graph     = node->graph;
+
+  if (graph->record_timings) {
+    node->start_ns  = eg_now_ns() - graph->run_start_ns;
+    node->worker_id = eg_worker_id;
+  }
+
+  node->routine(node->args);
+
+  if (graph->record_timings) {
+    node->end_ns = eg_now_ns() - graph->run_start_ns;
+  }
+
+  // The successors join the group before this node leaves it, so the group
+  // can't reach zero while there are nodes left to run
+  for (uint32_t i = 0; i < node->successor_count; i++) {
+    eg_task_graph_node_t *successor = &graph->nodes[node->successors[i]];
+
+    if (atomic_fetch_sub_explicit(
+            &successor->pending, 1, memory_order_acq_rel) == 1) {
+      eg_scheduler_add_task_to_group(
+          graph->scheduler, &graph->group, node_task, successor);
+    }
+  }
+
+  return 0;
+}
+
+void eg_task_graph_run(eg_task_graph_t *graph, eg_task_scheduler_t *scheduler) {
+  graph->scheduler = scheduler;
+  eg_task_group_init(&graph->group);
+
+  if (graph->record_timings) {
+    graph->run_start_ns = eg_now_ns();
+  }
+
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    eg_task_graph_node_t *node = &graph->nodes[i];
+    node->graph                = graph;
+    atomic_store_explicit(
+        &node->pending, node->predecessor_count, memory_order_relaxed);
+  }
+
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    if (graph->nodes[i].predecessor_count == 0) {
+      eg_scheduler_add_task_to_group(
+          scheduler, &graph->group, node_task, &graph->nodes[i]);
+    }
+  }
+
+  eg_task_group_wait(scheduler, &graph->group);
+}
+
+static int compare_start(const void *a, const void *b) {
+  const eg_task_graph_node_t *na = *(eg_task_graph_node_t *const *)a;
+  const eg_task_graph_node_t *nb = *(eg_task_graph_node_t *const *)b;
+  return (na->start_ns > nb->start_ns) - (na->start_ns < nb->start_ns);
+}
+
+void eg_task_graph_dump(eg_task_graph_t *graph, FILE *file) {
+  if (!graph->record_timings) {
+    fprintf(file, "Task graph timings are not being recorded\n");
+    return;
+  }
+
+  eg_task_graph_node_t **sorted = malloc(graph->node_count * sizeof(*sorted));
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    sorted[i] = &graph->nodes[i];
+  }
+  qsort(sorted, graph->node_count, sizeof(*sorted), compare_start);
+
+  fprintf(
+      file,
+      "%-24s %6s %12s %12s %12s\n",
+      "Node",
+      "Thread",
+      "Start (us)",
+      "End (us)",
+      "Time (us)");
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    eg_task_graph_node_t *node = sorted[i];
+    fprintf(
+        file,
+        "%-24s %6u %12.1f %12.1f %12.1f\n",
+        node->name,
+        node->worker_id,
+        (double)node->start_ns / 1000.0,
+        (double)node->end_ns / 1000.0,
+        (double)(node->end_ns - node->start_ns) / 1000.0);
+  }
+
+  free(sorted);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "task_scheduler.h"
+#include <stdio.h>
+
+/*
+ * A DAG of tasks, built once and run every frame. A node runs on the
+ * scheduler as soon as all of its predecessors have finished. Building the
+ * graph allocates, running it doesn't.
+ *
+ * With record_timings set, each run records when and on which thread every
+ * node ran, and eg_task_graph_dump prints the last schedule.
+ */
+
+typedef uint32_t eg_task_node_t;
+
+typedef struct eg_task_graph_node_t {
+  const char *name;
+  thrd_start_t routine;
+  void *args;
+  struct eg_task_graph_t *graph;
+
+  uint32_t *successors;
+  uint32_t successor_count;
+  uint32_t successor_cap;
+  uint32_t predecessor_count;
+
+  atomic_uint pending; // Predecessors that haven't finished in this run
+
+  // Filled in when the graph records timings
+  uint64_t start_ns;
+  uint64_t end_ns;
+  uint32_t worker_id;
+} eg_task_graph_node_t;
+
+typedef struct eg_task_graph_t {
+  eg_task_graph_node_t *nodes;
+  uint32_t node_count;
+  uint32_t node_cap;
+
+  bool record_timings;
+
+  // State of the current run
+  eg_task_scheduler_t *scheduler;
+  eg_task_group_t group;
+  uint64_t run_start_ns;
+} eg_task_graph_t;
+
+void eg_task_graph_init(eg_task_graph_t *graph);
+
+void eg_task_graph_destroy(eg_task_graph_t *graph);
+
+eg_task_node_t eg_task_graph_add_node(
+    eg_task_graph_t *graph, const char *name, thrd_start_t routine, void *args);
+
+// Makes `to` wait for `from` to finish
+void eg_task_graph_add_edge(
+    eg_task_graph_t *graph, eg_task_node_t from, eg_task_node_t to);
+
+// Runs every node once and waits for all of them. The calling thread helps
+// running the nodes while it waits.
+void eg_task_graph_run(eg_task_graph_t *graph, eg_task_scheduler_t *scheduler);
+
+// Prints the nodes of the last run ordered by start time, with the thread
+// they ran on and their start/end times relative to the start of the run
+void eg_task_graph_dump(eg_task_graph_t *graph, FILE *file);
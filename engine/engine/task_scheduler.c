@@ -1,129 +1,1069 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // pthread_setaffinity_np and pthread_setname_np
+#endif
+
 #include "task_scheduler.h"
+#include "util.h"
+#include <assert.h>
+#include <immintrin.h>
+#include <stdio.h>
 #include <stdlib.h>
 
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+#define DEQUE_MASK (EG_TASK_DEQUE_SIZE - 1)
+
+#define TASKS_PER_BLOCK 256
+
+#define DEFAULT_SPIN_COUNT 2000
+#define DEFAULT_YIELD_COUNT 16
+
+_Static_assert(
+    (EG_TASK_DEQUE_SIZE & DEQUE_MASK) == 0,
+    "EG_TASK_DEQUE_SIZE must be a power of two");
+
 _Thread_local uint32_t eg_worker_id = 0;
 
-static inline void
-task_init(eg_task_t *task, thrd_start_t routine, void *args) {
-  task->routine = routine;
-  task->args    = args;
-  task->next    = NULL;
+// The worker running on this thread, NULL for threads that aren't workers
+static _Thread_local eg_worker_t *current_worker = NULL;
+
+/*
+ * A job runs on its own stack (a fiber on Windows, a ucontext elsewhere), so it
+ * can switch back to the thread that resumed it halfway through. The stack is
+ * reused by the next job once the routine returns.
+ */
+typedef struct eg_job_t {
+  struct eg_job_t *next; // Free list or parked list
+  eg_task_scheduler_t *scheduler;
+  eg_task_group_t *group;
+  eg_task_priority_t priority;
+  thrd_start_t routine;
+  void *args;
+  bool finished;
+  eg_task_group_t *waiting_on; // Set by eg_job_wait before switching out
+
+#if defined(_WIN32)
+  void *fiber;
+  void *caller;
+#else
+  ucontext_t context;
+  ucontext_t *caller;
+  void *stack;
+#endif
+} eg_job_t;
+
+// The job running on this thread, NULL outside of jobs
+static _Thread_local eg_job_t *current_job = NULL;
+
+typedef struct eg_task_block_t {
+  struct eg_task_block_t *next;
+  eg_task_t tasks[TASKS_PER_BLOCK];
+} eg_task_block_t;
+
+static void pool_init(eg_task_pool_t *pool) {
+  pool->free   = NULL;
+  pool->blocks = NULL;
+  atomic_init(&pool->remote_free, NULL);
+}
+
+static void pool_destroy(eg_task_pool_t *pool) {
+  eg_task_block_t *block = pool->blocks;
+  while (block != NULL) {
+    eg_task_block_t *next = block->next;
+    free(block);
+    block = next;
+  }
+}
+
+// Owner only
+static eg_task_t *pool_alloc(eg_task_pool_t *pool) {
+  if (pool->free == NULL) {
+    // Take back everything other threads have freed in one go. Only the owner
+    // takes from remote_free, so this can't suffer from ABA.
+    pool->free = atomic_exchange_explicit(
+        &pool->remote_free, NULL, memory_order_acquire);
+  }
+
+  if (pool->free == NULL) {
+    eg_task_block_t *block = malloc(sizeof(*block));
+    block->next            = pool->blocks;
+    pool->blocks           = block;
+
+    for (uint32_t i = 0; i < TASKS_PER_BLOCK; i++) {
+      block->tasks[i].pool = pool;
+      block->tasks[i].next =
+          (i + 1 < TASKS_PER_BLOCK) ? &block->tasks[i + 1] : NULL;
+    }
+    pool->free = &block->tasks[0];
+  }
+
+  eg_task_t *task = pool->free;
+  pool->free      = task->next;
+  return task;
+}
+
+// Any thread
+static void pool_free(eg_task_t *task) {
+  eg_task_pool_t *pool = task->pool;
+
+  if (current_worker != NULL && pool == &current_worker->pool) {
+    task->next = pool->free;
+    pool->free = task;
+    return;
+  }
+
+  eg_task_t *head =
+      atomic_load_explicit(&pool->remote_free, memory_order_relaxed);
+  do {
+    task->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(
+      &pool->remote_free,
+      &head,
+      task,
+      memory_order_release,
+      memory_order_relaxed));
+}
+
+/*
+ * Deque operations, following "Correct and Efficient Work-Stealing for Weak
+ * Memory Models" (Lê et al. 2013)
+ */
+
+static void deque_init(eg_task_deque_t *deque) {
+  atomic_init(&deque->top, 0);
+  atomic_init(&deque->bottom, 0);
+  for (uint32_t i = 0; i < EG_TASK_DEQUE_SIZE; i++) {
+    atomic_init(&deque->tasks[i], NULL);
+  }
+}
+
+// Owner only. Returns false if the deque is full.
+static bool deque_push(eg_task_deque_t *deque, eg_task_t *task) {
+  int64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  int64_t t = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+  if (b - t >= EG_TASK_DEQUE_SIZE) {
+    return false;
+  }
+
+  atomic_store_explicit(
+      &deque->tasks[b & DEQUE_MASK], task, memory_order_relaxed);
+  atomic_store_explicit(&deque->bottom, b + 1, memory_order_release);
+
+  return true;
+}
+
+// Owner only
+static eg_task_t *deque_pop(eg_task_deque_t *deque) {
+  int64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  if (t > b) {
+    // Empty
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    return NULL;
+  }
+
+  eg_task_t *task =
+      atomic_load_explicit(&deque->tasks[b & DEQUE_MASK], memory_order_relaxed);
+
+  if (t == b) {
+    // Last task, race the thieves for it
+    if (!atomic_compare_exchange_strong_explicit(
+            &deque->top,
+            &t,
+            t + 1,
+            memory_order_seq_cst,
+            memory_order_relaxed)) {
+      task = NULL;
+    }
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+  }
+
+  return task;
+}
+
+// Any thread. Returns NULL if the deque is empty or another thread won the
+// race for the top task.
+static eg_task_t *deque_steal(eg_task_deque_t *deque) {
+  int64_t t = atomic_load_explicit(&deque->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+  if (t >= b) {
+    return NULL;
+  }
+
+  eg_task_t *task =
+      atomic_load_explicit(&deque->tasks[t & DEQUE_MASK], memory_order_relaxed);
+
+  if (!atomic_compare_exchange_strong_explicit(
+          &deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+    return NULL;
+  }
+
+  return task;
+}
+
+static inline uint32_t xorshift32(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+static eg_task_t *
+queue_pop(eg_task_scheduler_t *scheduler, eg_task_priority_t lane) {
+  eg_task_queue_t *queue = &scheduler->queues[lane];
+
+  mtx_lock(&scheduler->mutex);
+  eg_task_t *task = queue->head;
+  if (task != NULL) {
+    queue->head = task->next;
+    if (queue->head == NULL) {
+      queue->tail = NULL;
+    }
+    atomic_fetch_sub_explicit(&queue->count, 1, memory_order_relaxed);
+  }
+  mtx_unlock(&scheduler->mutex);
+
+  return task;
 }
 
-static inline void
-task_append(eg_task_t *task, thrd_start_t routine, void *args) {
-  if (task->next != NULL) {
-    task_append(task->next, routine, args);
+// Called with the scheduler's mutex locked
+static void queue_push(eg_task_scheduler_t *scheduler, eg_task_t *task) {
+  eg_task_queue_t *queue = &scheduler->queues[task->priority];
+
+  task->next = NULL;
+
+  if (queue->tail != NULL) {
+    queue->tail->next = task;
   } else {
-    task->next = (eg_task_t *)malloc(sizeof(eg_task_t));
-    task_init(task->next, routine, args);
+    queue->head = task;
   }
+  queue->tail = task;
+  atomic_fetch_add_explicit(&queue->count, 1, memory_order_relaxed);
 }
 
-int worker_routine(void *args) {
-  eg_worker_t *worker = (eg_worker_t *)args;
+static inline uint32_t
+lane_count(eg_task_scheduler_t *scheduler, eg_task_priority_t lane) {
+  return atomic_load_explicit(
+      &scheduler->task_counts[lane], memory_order_relaxed);
+}
 
-  eg_worker_id = worker->id;
+// Whether there are tasks that an idle worker is allowed to take
+static inline bool has_work(eg_task_scheduler_t *scheduler) {
+  if (lane_count(scheduler, EG_TASK_PRIORITY_HIGH) > 0 ||
+      lane_count(scheduler, EG_TASK_PRIORITY_NORMAL) > 0) {
+    return true;
+  }
 
-  eg_task_t *curr_task = NULL;
+  return lane_count(scheduler, EG_TASK_PRIORITY_BACKGROUND) > 0 &&
+         atomic_load(&scheduler->background_busy) <
+             scheduler->max_background_workers;
+}
 
-  while (1) {
-    while (!worker->scheduler->stop && worker->scheduler->task == NULL) {
-      cnd_wait(&worker->scheduler->wait_cond, &worker->scheduler->mutex);
+// Looks for a task of one lane in the worker's own deque, then in the shared
+// queue, then in the deques of the other workers, starting from a random one
+static eg_task_t *find_task_in_lane(
+    eg_task_scheduler_t *scheduler,
+    eg_worker_t *self,
+    eg_task_priority_t lane) {
+  eg_task_t *task = NULL;
+
+  if (lane_count(scheduler, lane) == 0) {
+    return NULL;
+  }
+
+  if (self != NULL && (task = deque_pop(&self->deques[lane])) != NULL) {
+    return task;
+  }
+
+  if (atomic_load_explicit(
+          &scheduler->queues[lane].count, memory_order_relaxed) > 0 &&
+      (task = queue_pop(scheduler, lane)) != NULL) {
+    return task;
+  }
+
+  uint32_t first = 0;
+  if (self != NULL) {
+    first = xorshift32(&self->rng) % scheduler->num_workers;
+  }
+
+  for (uint32_t i = 0; i < scheduler->num_workers; i++) {
+    eg_worker_t *victim =
+        &scheduler->workers[(first + i) % scheduler->num_workers];
+    if (victim == self) continue;
+
+    if ((task = deque_steal(&victim->deques[lane])) != NULL) {
+      return task;
     }
+  }
+
+  return NULL;
+}
+
+// Goes through the lanes from highest to lowest priority. Background tasks are
+// only taken when `allow_background` is set and a background slot is free,
+// which stays taken until the task finishes.
+static eg_task_t *find_task(
+    eg_task_scheduler_t *scheduler,
+    eg_worker_t *self,
+    bool allow_background) {
+  eg_task_t *task = NULL;
 
-    if (worker->scheduler->stop) {
-      mtx_unlock(&worker->scheduler->mutex);
-      return 0;
+  for (uint32_t lane = 0; lane < EG_TASK_PRIORITY_BACKGROUND; lane++) {
+    if ((task = find_task_in_lane(scheduler, self, lane)) != NULL) {
+      return task;
     }
+  }
+
+  if (!allow_background ||
+      lane_count(scheduler, EG_TASK_PRIORITY_BACKGROUND) == 0) {
+    return NULL;
+  }
 
-    curr_task = worker->scheduler->task;
-    if (worker->scheduler->task != NULL) {
-      worker->scheduler->task = worker->scheduler->task->next;
+  uint32_t busy = atomic_load(&scheduler->background_busy);
+  while (busy < scheduler->max_background_workers) {
+    if (atomic_compare_exchange_weak(
+            &scheduler->background_busy, &busy, busy + 1)) {
+      task = find_task_in_lane(scheduler, self, EG_TASK_PRIORITY_BACKGROUND);
+      if (task == NULL) {
+        atomic_fetch_sub(&scheduler->background_busy, 1);
+      }
+      return task;
     }
-    mtx_unlock(&worker->scheduler->mutex);
+  }
+
+  return NULL;
+}
+
+static void wake_worker(eg_task_scheduler_t *scheduler) {
+  if (atomic_load(&scheduler->sleeping) > 0) {
+    // Taking the mutex makes sure a worker that is about to sleep either sees
+    // the new state or gets the signal
+    mtx_lock(&scheduler->mutex);
+    mtx_unlock(&scheduler->mutex);
+    cnd_signal(&scheduler->wait_cond);
+  }
+}
+
+static void push_task(
+    eg_task_scheduler_t *scheduler,
+    eg_task_priority_t priority,
+    eg_task_group_t *group,
+    thrd_start_t routine,
+    void *args);
+
+static void wake_parked_jobs(
+    eg_task_scheduler_t *scheduler, eg_task_group_t *group);
+
+static void finish_group_task(
+    eg_task_scheduler_t *scheduler,
+    eg_task_group_t *group,
+    eg_task_priority_t priority) {
+  // Read the continuation first: once the count reaches zero a waiting thread
+  // can return and destroy the group
+  thrd_start_t continuation           = group->continuation;
+  void *continuation_args             = group->continuation_args;
+  eg_task_group_t *continuation_group = group->continuation_group;
+
+  // Sequentially consistent so that it's ordered with parked_count, see
+  // park_job
+  if (atomic_fetch_sub(&group->count, 1) != 1) {
+    return;
+  }
+
+  if (atomic_load(&scheduler->parked_count) > 0) {
+    wake_parked_jobs(scheduler, group);
+  }
 
-    if (curr_task != NULL) {
-      curr_task->routine(curr_task->args);
+  if (continuation != NULL) {
+    // The continuation was already counted in its group when it was set
+    push_task(
+        scheduler,
+        priority,
+        continuation_group,
+        continuation,
+        continuation_args);
+  }
+}
 
-      free(curr_task);
+static inline void run_task(eg_task_scheduler_t *scheduler, eg_task_t *task) {
+  atomic_fetch_sub(&scheduler->task_counts[task->priority], 1);
+
+  // Free the task before running it, so the tasks it adds can reuse it
+  thrd_start_t routine        = task->routine;
+  void *args                  = task->args;
+  eg_task_group_t *group      = task->group;
+  eg_task_priority_t priority = task->priority;
+  pool_free(task);
+
+  routine(args);
+
+  if (priority == EG_TASK_PRIORITY_BACKGROUND) {
+    // Free the background slot, which might let a sleeping worker take the
+    // next background task
+    atomic_fetch_sub(&scheduler->background_busy, 1);
+    if (lane_count(scheduler, EG_TASK_PRIORITY_BACKGROUND) > 0) {
+      wake_worker(scheduler);
     }
+  }
 
-    cnd_signal(&worker->scheduler->done_cond);
+  if (group != NULL) {
+    finish_group_task(scheduler, group, priority);
   }
+}
 
-  return 0;
+static inline bool all_tasks_taken(eg_task_scheduler_t *scheduler) {
+  for (uint32_t lane = 0; lane < EG_TASK_PRIORITY_MAX; lane++) {
+    if (atomic_load(&scheduler->task_counts[lane]) > 0) return false;
+  }
+  return true;
 }
 
-static inline void
-worker_init(eg_worker_t *worker, eg_task_scheduler_t *scheduler, uint32_t id) {
-  worker->id        = id;
-  worker->scheduler = scheduler;
-  worker->working   = false;
-  thrd_create(&worker->thread, worker_routine, worker);
-  mtx_init(&worker->mutex, mtx_plain);
+static void worker_sleep(eg_task_scheduler_t *scheduler) {
+  mtx_lock(&scheduler->mutex);
+  atomic_fetch_add(&scheduler->sleeping, 1);
+  while (!has_work(scheduler) && !atomic_load(&scheduler->stop)) {
+    cnd_wait(&scheduler->wait_cond, &scheduler->mutex);
+  }
+  atomic_fetch_sub(&scheduler->sleeping, 1);
+  mtx_unlock(&scheduler->mutex);
+}
+
+static void set_thread_name(const char *name) {
+#if defined(_WIN32)
+  wchar_t wname[32];
+  mbstowcs(wname, name, sizeof(wname) / sizeof(wname[0]));
+  SetThreadDescription(GetCurrentThread(), wname);
+#elif defined(__APPLE__)
+  pthread_setname_np(name);
+#elif defined(__linux__)
+  pthread_setname_np(pthread_self(), name); // At most 15 characters
+#endif
 }
 
-static inline void worker_wait(eg_worker_t *worker) {
-  thrd_join(worker->thread, NULL);
+static void pin_thread(uint32_t core) {
+#if defined(_WIN32)
+  SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core);
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void)core; // No affinity API on macOS
+#endif
 }
 
-static inline void worker_destroy(eg_worker_t *worker) {
-  mtx_destroy(&worker->mutex);
+uint32_t eg_cpu_core_count(void) {
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  long count = (long)info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return count > 0 ? (uint32_t)count : 1;
 }
 
-void eg_scheduler_init(eg_task_scheduler_t *scheduler, uint32_t num_workers) {
+int worker_routine(void *args) {
+  eg_worker_t *worker            = (eg_worker_t *)args;
+  eg_task_scheduler_t *scheduler = worker->scheduler;
+
+  eg_worker_id   = worker->id;
+  current_worker = worker;
+
+  char name[16];
+  snprintf(name, sizeof(name), "eg-worker-%u", worker->id);
+  set_thread_name(name);
+
+  if (scheduler->pin_workers) {
+    // The main thread is left core 0
+    pin_thread(worker->id % eg_cpu_core_count());
+  }
+
+  // Spin for a while first so short gaps between tasks don't pay for a
+  // wake-up, then yield, then park on the condition variable
+  uint32_t idle = 0;
+
+  while (1) {
+    eg_task_t *task = find_task(scheduler, worker, true);
+    if (task != NULL) {
+      run_task(scheduler, task);
+      idle = 0;
+      continue;
+    }
+
+    // A task might still be in a deque that find_task raced on, so only stop
+    // once the counter says everything was taken
+    if (atomic_load(&scheduler->stop) && all_tasks_taken(scheduler)) {
+      break;
+    }
+
+    idle++;
+    if (idle <= scheduler->spin_count) {
+      _mm_pause();
+    } else if (idle <= scheduler->spin_count + scheduler->yield_count) {
+      thrd_yield();
+    } else {
+      worker_sleep(scheduler);
+      idle = 0;
+    }
+  }
+
+  current_worker = NULL;
+
+  return 0;
+}
+
+eg_scheduler_options_t eg_default_scheduler_options(void) {
+  return (eg_scheduler_options_t){
+      .num_workers            = 0,
+      .spin_count             = DEFAULT_SPIN_COUNT,
+      .yield_count            = DEFAULT_YIELD_COUNT,
+      .pin_workers            = false,
+      .max_background_workers = 0,
+  };
+}
+
+void eg_scheduler_init(
+    eg_task_scheduler_t *scheduler, const eg_scheduler_options_t *options) {
+  eg_scheduler_options_t default_options = eg_default_scheduler_options();
+  if (options == NULL) {
+    options = &default_options;
+  }
+
+  uint32_t num_workers = options->num_workers;
+  if (num_workers == 0) {
+    // One worker per core besides the one running the main thread
+    uint32_t core_count = eg_cpu_core_count();
+    num_workers         = core_count > 1 ? core_count - 1 : 1;
+    if (num_workers > EG_MAX_THREADS - 1) {
+      num_workers = EG_MAX_THREADS - 1;
+    }
+  }
+
+  assert(num_workers < EG_MAX_THREADS);
+
   scheduler->num_workers = num_workers;
+  scheduler->spin_count  = options->spin_count;
+  scheduler->yield_count = options->yield_count;
+  scheduler->pin_workers = options->pin_workers;
+
+  scheduler->max_background_workers = options->max_background_workers;
+  if (scheduler->max_background_workers == 0) {
+    scheduler->max_background_workers =
+        num_workers > 1 ? num_workers / 2 : 1;
+  }
+
   scheduler->workers =
       (eg_worker_t *)malloc(sizeof(eg_worker_t) * scheduler->num_workers);
-  scheduler->task = NULL;
-  scheduler->stop = false;
+
+  for (uint32_t lane = 0; lane < EG_TASK_PRIORITY_MAX; lane++) {
+    scheduler->queues[lane].head = NULL;
+    scheduler->queues[lane].tail = NULL;
+    atomic_init(&scheduler->queues[lane].count, 0);
+    atomic_init(&scheduler->task_counts[lane], 0);
+  }
+
+  pool_init(&scheduler->external_pool);
+  atomic_init(&scheduler->background_busy, 0);
+  atomic_init(&scheduler->sleeping, 0);
+
+  atomic_init(&scheduler->main_incoming, NULL);
+  scheduler->main_head = NULL;
+  scheduler->main_tail = NULL;
+
+  scheduler->free_jobs   = NULL;
+  scheduler->parked_jobs = NULL;
+  atomic_init(&scheduler->parked_count, 0);
+  atomic_init(&scheduler->stop, false);
   cnd_init(&scheduler->wait_cond);
-  cnd_init(&scheduler->done_cond);
   mtx_init(&scheduler->mutex, mtx_plain);
+
+  // Initialize all the deques before any worker can try to steal from them
+  for (uint32_t i = 0; i < scheduler->num_workers; i++) {
+    eg_worker_t *worker = &scheduler->workers[i];
+    worker->id          = i + 1;
+    worker->scheduler   = scheduler;
+    worker->rng         = 0x9E3779B9u * (i + 1);
+    pool_init(&worker->pool);
+    for (uint32_t lane = 0; lane < EG_TASK_PRIORITY_MAX; lane++) {
+      deque_init(&worker->deques[lane]);
+    }
+  }
+
   for (uint32_t i = 0; i < scheduler->num_workers; i++) {
-    worker_init(&scheduler->workers[i], scheduler, i);
+    thrd_create(
+        &scheduler->workers[i].thread, worker_routine, &scheduler->workers[i]);
+  }
+}
+
+static void push_shared_task(
+    eg_task_scheduler_t *scheduler,
+    eg_task_priority_t priority,
+    eg_task_group_t *group,
+    thrd_start_t routine,
+    void *args) {
+  mtx_lock(&scheduler->mutex);
+  eg_task_t *task = pool_alloc(&scheduler->external_pool);
+  task->group     = group;
+  task->priority  = priority;
+  task->routine   = routine;
+  task->args      = args;
+  queue_push(scheduler, task);
+  mtx_unlock(&scheduler->mutex);
+}
+
+static void push_task(
+    eg_task_scheduler_t *scheduler,
+    eg_task_priority_t priority,
+    eg_task_group_t *group,
+    thrd_start_t routine,
+    void *args) {
+  // Count the task before publishing it, so it's never taken before being
+  // counted
+  atomic_fetch_add(&scheduler->task_counts[priority], 1);
+
+  eg_worker_t *worker = current_worker;
+  if (worker != NULL && worker->scheduler == scheduler) {
+    eg_task_t *task = pool_alloc(&worker->pool);
+    task->group     = group;
+    task->priority  = priority;
+    task->routine   = routine;
+    task->args      = args;
+
+    if (!deque_push(&worker->deques[priority], task)) {
+      mtx_lock(&scheduler->mutex);
+      queue_push(scheduler, task);
+      mtx_unlock(&scheduler->mutex);
+    }
+  } else {
+    push_shared_task(scheduler, priority, group, routine, args);
   }
+
+  wake_worker(scheduler);
 }
 
 void eg_scheduler_add_task(
     eg_task_scheduler_t *scheduler, thrd_start_t routine, void *args) {
-  mtx_lock(&scheduler->mutex);
-  if (scheduler->task == NULL) {
-    scheduler->task = (eg_task_t *)malloc(sizeof(eg_task_t));
-    task_init(scheduler->task, routine, args);
+  push_task(scheduler, EG_TASK_PRIORITY_NORMAL, NULL, routine, args);
+}
+
+void eg_scheduler_add_task_to_group(
+    eg_task_scheduler_t *scheduler,
+    eg_task_group_t *group,
+    thrd_start_t routine,
+    void *args) {
+  atomic_fetch_add_explicit(&group->count, 1, memory_order_relaxed);
+  push_task(scheduler, EG_TASK_PRIORITY_NORMAL, group, routine, args);
+}
+
+void eg_scheduler_add_priority_task(
+    eg_task_scheduler_t *scheduler,
+    eg_task_priority_t priority,
+    eg_task_group_t *group,
+    thrd_start_t routine,
+    void *args) {
+  assert(priority < EG_TASK_PRIORITY_MAX);
+
+  if (group != NULL) {
+    atomic_fetch_add_explicit(&group->count, 1, memory_order_relaxed);
+  }
+  push_task(scheduler, priority, group, routine, args);
+}
+
+void eg_scheduler_add_main_task(
+    eg_task_scheduler_t *scheduler, thrd_start_t routine, void *args) {
+  eg_worker_t *worker = current_worker;
+
+  eg_task_t *task;
+  if (worker != NULL && worker->scheduler == scheduler) {
+    task = pool_alloc(&worker->pool);
   } else {
-    task_append(scheduler->task, routine, args);
+    mtx_lock(&scheduler->mutex);
+    task = pool_alloc(&scheduler->external_pool);
+    mtx_unlock(&scheduler->mutex);
   }
-  mtx_unlock(&scheduler->mutex);
 
-  cnd_signal(&scheduler->wait_cond);
+  task->group    = NULL;
+  task->priority = EG_TASK_PRIORITY_HIGH;
+  task->routine  = routine;
+  task->args     = args;
+
+  eg_task_t *head =
+      atomic_load_explicit(&scheduler->main_incoming, memory_order_relaxed);
+  do {
+    task->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(
+      &scheduler->main_incoming,
+      &head,
+      task,
+      memory_order_release,
+      memory_order_relaxed));
 }
 
-void eg_scheduler_destroy(eg_task_scheduler_t *scheduler) {
-  while (1) {
-    cnd_wait(&scheduler->done_cond, &scheduler->mutex);
-    if (scheduler->task == NULL) {
-      scheduler->stop = true;
-      mtx_unlock(&scheduler->mutex);
+uint32_t
+eg_scheduler_run_main_tasks(eg_task_scheduler_t *scheduler, double budget) {
+  // Take everything added since the last call and append it to the FIFO in
+  // the order it was added
+  eg_task_t *incoming = atomic_exchange_explicit(
+      &scheduler->main_incoming, NULL, memory_order_acquire);
+
+  eg_task_t *reversed = NULL;
+  eg_task_t *last     = incoming;
+  while (incoming != NULL) {
+    eg_task_t *next = incoming->next;
+    incoming->next  = reversed;
+    reversed        = incoming;
+    incoming        = next;
+  }
+
+  if (reversed != NULL) {
+    if (scheduler->main_tail != NULL) {
+      scheduler->main_tail->next = reversed;
+    } else {
+      scheduler->main_head = reversed;
+    }
+    scheduler->main_tail = last;
+  }
+
+  uint64_t start     = eg_now_ns();
+  uint64_t budget_ns = (uint64_t)(budget * 1e9);
+  uint32_t ran       = 0;
+
+  while (scheduler->main_head != NULL) {
+    if (ran > 0 && eg_now_ns() - start >= budget_ns) {
       break;
     }
+
+    eg_task_t *task      = scheduler->main_head;
+    scheduler->main_head = task->next;
+    if (scheduler->main_head == NULL) {
+      scheduler->main_tail = NULL;
+    }
+
+    thrd_start_t routine = task->routine;
+    void *args           = task->args;
+    pool_free(task);
+
+    routine(args);
+    ran++;
+  }
+
+  return ran;
+}
+
+static void job_loop(eg_job_t *job);
+
+#if defined(_WIN32)
+static void WINAPI job_entry(void *args) { job_loop(args); }
+
+static void job_create_context(eg_job_t *job) {
+  job->fiber = CreateFiber(EG_JOB_STACK_SIZE, job_entry, job);
+}
+
+static void job_destroy_context(eg_job_t *job) { DeleteFiber(job->fiber); }
+
+static void job_switch_in(eg_job_t *job) {
+  if (!IsThreadAFiber()) {
+    ConvertThreadToFiber(NULL);
+  }
+  job->caller = GetCurrentFiber();
+  SwitchToFiber(job->fiber);
+}
+
+static void job_switch_out(eg_job_t *job) { SwitchToFiber(job->caller); }
+#else
+// makecontext can only pass ints, so the job is read from current_job, which
+// is set before the first switch
+static void job_entry(void) { job_loop(current_job); }
+
+static void job_create_context(eg_job_t *job) {
+  job->stack = malloc(EG_JOB_STACK_SIZE);
+
+  getcontext(&job->context);
+  job->context.uc_stack.ss_sp   = job->stack;
+  job->context.uc_stack.ss_size = EG_JOB_STACK_SIZE;
+  job->context.uc_link          = NULL;
+  makecontext(&job->context, job_entry, 0);
+}
+
+static void job_destroy_context(eg_job_t *job) { free(job->stack); }
+
+static void job_switch_in(eg_job_t *job) {
+  ucontext_t caller;
+  job->caller = &caller;
+  swapcontext(&caller, &job->context);
+}
+
+static void job_switch_out(eg_job_t *job) {
+  swapcontext(&job->context, job->caller);
+}
+#endif
+
+static void job_loop(eg_job_t *job) {
+  while (1) {
+    job->routine(job->args);
+    job->finished = true;
+    job_switch_out(job);
+  }
+}
+
+static int job_task(void *args);
+
+static void requeue_job(eg_task_scheduler_t *scheduler, eg_job_t *job) {
+  // Requeued jobs go to the back of the shared queue, so this thread first
+  // runs the tasks from its own deque
+  atomic_fetch_add(&scheduler->task_counts[job->priority], 1);
+  push_shared_task(scheduler, job->priority, NULL, job_task, job);
+  wake_worker(scheduler);
+}
+
+// Puts a job that is waiting on a group in the parked list, where the task
+// that brings the group's count to zero finds it. The count is checked after
+// parked_count is incremented, and finish_group_task checks parked_count after
+// decrementing the count, so one of them always sees the other.
+static void park_job(eg_task_scheduler_t *scheduler, eg_job_t *job) {
+  mtx_lock(&scheduler->mutex);
+  atomic_fetch_add(&scheduler->parked_count, 1);
+
+  if (atomic_load(&job->waiting_on->count) == 0) {
+    atomic_fetch_sub(&scheduler->parked_count, 1);
     mtx_unlock(&scheduler->mutex);
+
+    job->waiting_on = NULL;
+    requeue_job(scheduler, job);
+    return;
+  }
+
+  job->next              = scheduler->parked_jobs;
+  scheduler->parked_jobs = job;
+  mtx_unlock(&scheduler->mutex);
+}
+
+// The group may have been destroyed by now, so it's only compared with
+static void wake_parked_jobs(
+    eg_task_scheduler_t *scheduler, eg_task_group_t *group) {
+  eg_job_t *woken = NULL;
+
+  mtx_lock(&scheduler->mutex);
+  eg_job_t **link = &scheduler->parked_jobs;
+  while (*link != NULL) {
+    eg_job_t *job = *link;
+    if (job->waiting_on == group) {
+      *link           = job->next;
+      job->waiting_on = NULL;
+      job->next       = woken;
+      woken           = job;
+      atomic_fetch_sub(&scheduler->parked_count, 1);
+    } else {
+      link = &job->next;
+    }
+  }
+  mtx_unlock(&scheduler->mutex);
+
+  while (woken != NULL) {
+    eg_job_t *next = woken->next;
+    requeue_job(scheduler, woken);
+    woken = next;
+  }
+}
+
+// Runs a job until it returns, yields or waits
+static int job_task(void *args) {
+  eg_job_t *job = args;
+
+  // Jobs can start other jobs and wait on them with a helping wait, so the
+  // previous job has to be restored afterwards
+  eg_job_t *previous = current_job;
+  current_job        = job;
+  job_switch_in(job);
+  current_job = previous;
+
+  eg_task_scheduler_t *scheduler = job->scheduler;
+
+  // The job can only be resumed once it has switched out, so it's parked or
+  // requeued from here instead of from the job itself
+  if (job->waiting_on != NULL) {
+    park_job(scheduler, job);
+    return 0;
+  }
+
+  if (!job->finished) {
+    requeue_job(scheduler, job);
+    return 0;
+  }
+
+  eg_task_group_t *group      = job->group;
+  eg_task_priority_t priority = job->priority;
+
+  mtx_lock(&scheduler->mutex);
+  job->next            = scheduler->free_jobs;
+  scheduler->free_jobs = job;
+  mtx_unlock(&scheduler->mutex);
+
+  if (group != NULL) {
+    finish_group_task(scheduler, group, priority);
   }
 
+  return 0;
+}
+
+void eg_scheduler_add_job(
+    eg_task_scheduler_t *scheduler,
+    eg_task_priority_t priority,
+    eg_task_group_t *group,
+    thrd_start_t routine,
+    void *args) {
+  assert(priority < EG_TASK_PRIORITY_MAX);
+
+  mtx_lock(&scheduler->mutex);
+  eg_job_t *job = scheduler->free_jobs;
+  if (job != NULL) {
+    scheduler->free_jobs = job->next;
+  }
+  mtx_unlock(&scheduler->mutex);
+
+  if (job == NULL) {
+    job = malloc(sizeof(*job));
+    job_create_context(job);
+  }
+
+  job->scheduler = scheduler;
+  job->group     = group;
+  job->priority  = priority;
+  job->routine   = routine;
+  job->args       = args;
+  job->finished   = false;
+  job->waiting_on = NULL;
+
+  // The job counts as a single task of the group until its routine returns
+  if (group != NULL) {
+    atomic_fetch_add_explicit(&group->count, 1, memory_order_relaxed);
+  }
+  push_task(scheduler, priority, NULL, job_task, job);
+}
+
+eg_task_scheduler_t *eg_current_scheduler(void) {
+  return current_worker != NULL ? current_worker->scheduler : NULL;
+}
+
+bool eg_in_job(void) { return current_job != NULL; }
+
+void eg_job_yield(void) {
+  eg_job_t *job = current_job;
+  assert(job != NULL && "eg_job_yield must be called from a job");
+  job_switch_out(job);
+}
+
+void eg_job_wait(eg_task_group_t *group) {
+  eg_job_t *job = current_job;
+  assert(job != NULL && "eg_job_wait must be called from a job");
+
+  // Wakes up can be spurious (from a destroyed group at the same address), so
+  // the count is checked again
+  while (atomic_load_explicit(&group->count, memory_order_acquire) > 0) {
+    job->waiting_on = group;
+    job_switch_out(job);
+  }
+}
+
+void eg_scheduler_destroy(eg_task_scheduler_t *scheduler) {
+  atomic_store(&scheduler->stop, true);
+
+  mtx_lock(&scheduler->mutex);
+  mtx_unlock(&scheduler->mutex);
   cnd_broadcast(&scheduler->wait_cond);
 
+  // Workers only exit once every task has been taken
   for (uint32_t i = 0; i < scheduler->num_workers; i++) {
-    worker_wait(&scheduler->workers[i]);
+    thrd_join(scheduler->workers[i].thread, NULL);
+  }
+
+  while (scheduler->main_head != NULL ||
+         atomic_load(&scheduler->main_incoming) != NULL) {
+    eg_scheduler_run_main_tasks(scheduler, 1.0);
+  }
+
+  // Every job has finished by now, so they're all in the free list
+  eg_job_t *job = scheduler->free_jobs;
+  while (job != NULL) {
+    eg_job_t *next = job->next;
+    job_destroy_context(job);
+    free(job);
+    job = next;
   }
 
   for (uint32_t i = 0; i < scheduler->num_workers; i++) {
-    worker_destroy(&scheduler->workers[i]);
+    pool_destroy(&scheduler->workers[i].pool);
   }
+  pool_destroy(&scheduler->external_pool);
 
   cnd_destroy(&scheduler->wait_cond);
-  cnd_destroy(&scheduler->done_cond);
   mtx_destroy(&scheduler->mutex);
 
   free(scheduler->workers);
 }
+
+void eg_task_group_init(eg_task_group_t *group) {
+  atomic_init(&group->count, 0);
+  group->continuation       = NULL;
+  group->continuation_args  = NULL;
+  group->continuation_group = NULL;
+}
+
+void eg_task_group_set_continuation(
+    eg_task_group_t *group,
+    thrd_start_t routine,
+    void *args,
+    eg_task_group_t *continuation_group) {
+  group->continuation       = routine;
+  group->continuation_args  = args;
+  group->continuation_group = continuation_group;
+
+  if (continuation_group != NULL) {
+    atomic_fetch_add_explicit(
+        &continuation_group->count, 1, memory_order_relaxed);
+  }
+
+  // Dropped by eg_task_group_seal
+  atomic_fetch_add_explicit(&group->count, 1, memory_order_relaxed);
+}
+
+void eg_task_group_seal(
+    eg_task_scheduler_t *scheduler, eg_task_group_t *group) {
+  assert(group->continuation != NULL && "only groups with a continuation");
+  finish_group_task(scheduler, group, EG_TASK_PRIORITY_NORMAL);
+}
+
+void eg_task_group_wait(
+    eg_task_scheduler_t *scheduler, eg_task_group_t *group) {
+  eg_worker_t *self = current_worker;
+  if (self != NULL && self->scheduler != scheduler) {
+    self = NULL;
+  }
+
+  while (atomic_load_explicit(&group->count, memory_order_acquire) > 0) {
+    // Background tasks could keep this thread busy long after the group is
+    // done, so they're left to the workers
+    eg_task_t *task = find_task(scheduler, self, false);
+    if (task != NULL) {
+      run_task(scheduler, task);
+    } else {
+      thrd_yield();
+    }
+  }
+}
@@ -1,38 +1,249 @@
 #pragma once
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <tinycthread.h>
 
+// Maximum amount of threads that can use the engine, including the main one
+#define EG_MAX_THREADS 64
+
+// Capacity of each worker's deque, must be a power of two. Tasks pushed to a
+// full deque go to the scheduler's shared queue instead.
+#define EG_TASK_DEQUE_SIZE 4096
+
+// Size of the stack each job runs on, see eg_scheduler_add_job
+#define EG_JOB_STACK_SIZE (256 * 1024)
+
+// 0 on the main thread, 1 to num_workers on the scheduler's workers
 extern _Thread_local uint32_t eg_worker_id;
 
+// Workers take tasks from higher priority lanes first
+typedef enum eg_task_priority_t {
+  EG_TASK_PRIORITY_HIGH,   // Latency critical work needed for this frame
+  EG_TASK_PRIORITY_NORMAL, // Everything else
+  // Long running work (asset decoding, streaming). Only a limited amount of
+  // workers run these at once, and waiting threads don't pick them up.
+  EG_TASK_PRIORITY_BACKGROUND,
+  EG_TASK_PRIORITY_MAX,
+} eg_task_priority_t;
+
 typedef struct eg_task_t {
-  struct eg_task_t *next;
+  struct eg_task_t *next; // Shared queue or free list
+  struct eg_task_pool_t *pool;
+  struct eg_task_group_t *group;
+  eg_task_priority_t priority;
   thrd_start_t routine;
   void *args;
 } eg_task_t;
 
+/*
+ * Counts the tasks added to it that haven't finished yet, so a thread can wait
+ * for a set of tasks (fork-join), or chain more work after them with a
+ * continuation.
+ */
+typedef struct eg_task_group_t {
+  atomic_uint count;
+
+  // Added to the scheduler when the count reaches zero, in the
+  // continuation_group (if any)
+  thrd_start_t continuation;
+  void *continuation_args;
+  struct eg_task_group_t *continuation_group;
+} eg_task_group_t;
+
+/*
+ * Tasks are allocated from the pool of the thread that adds them, in blocks
+ * that are never freed until the scheduler is destroyed. The owner keeps a
+ * private free list, and tasks that finish on other threads are handed back
+ * through the lock-free remote_free list, so in steady state adding and
+ * running tasks doesn't touch the heap.
+ */
+typedef struct eg_task_pool_t {
+  eg_task_t *free;                  // Only touched by the owner
+  _Atomic(eg_task_t *) remote_free; // Pushed by any thread
+  struct eg_task_block_t *blocks;
+} eg_task_pool_t;
+
+/*
+ * Chase-Lev work-stealing deque. The owning worker pushes and pops tasks at
+ * the bottom without locking, other workers steal from the top.
+ */
+typedef struct eg_task_deque_t {
+  _Atomic(int64_t) top;
+  char pad[64 - sizeof(int64_t)]; // Keep top and bottom on separate lines
+  _Atomic(int64_t) bottom;
+  _Atomic(eg_task_t *) tasks[EG_TASK_DEQUE_SIZE];
+} eg_task_deque_t;
+
 typedef struct eg_worker_t {
   uint32_t id;
   struct eg_task_scheduler_t *scheduler;
-  bool working;
-  mtx_t mutex;
+  uint32_t rng; // Picks the workers to steal from
   thrd_t thread;
+  eg_task_pool_t pool;
+  eg_task_deque_t deques[EG_TASK_PRIORITY_MAX];
 } eg_worker_t;
 
+typedef struct eg_task_queue_t {
+  eg_task_t *head;
+  eg_task_t *tail;
+  atomic_uint count; // Checked before taking the mutex
+} eg_task_queue_t;
+
+typedef struct eg_scheduler_options_t {
+  // 0 picks one worker per core, minus the one for the main thread
+  uint32_t num_workers;
+
+  // When they run out of tasks, workers busy-wait for spin_count iterations,
+  // then yield yield_count times before sleeping on a condition variable
+  uint32_t spin_count;
+  uint32_t yield_count;
+
+  // Pins worker N to core N, leaving core 0 for the main thread
+  bool pin_workers;
+
+  // How many workers can run background tasks at once. 0 picks half of the
+  // workers (at least one).
+  uint32_t max_background_workers;
+} eg_scheduler_options_t;
+
 typedef struct eg_task_scheduler_t {
   uint32_t num_workers;
   eg_worker_t *workers;
+
+  uint32_t spin_count;
+  uint32_t yield_count;
+  bool pin_workers;
+  uint32_t max_background_workers;
+
+  // Tasks added from threads that aren't workers of this scheduler (or that
+  // didn't fit in a worker's deque), one queue per lane
   mtx_t mutex;
+  eg_task_queue_t queues[EG_TASK_PRIORITY_MAX];
+  eg_task_pool_t external_pool; // Also protected by the mutex
+
+  // Workers sleep on wait_cond when there are no tasks they can take
   cnd_t wait_cond;
-  cnd_t done_cond;
-  eg_task_t *task;
-  bool stop;
+  // Tasks added but not taken by a worker yet, per lane
+  atomic_uint task_counts[EG_TASK_PRIORITY_MAX];
+  atomic_uint background_busy; // Workers running background tasks
+  atomic_uint sleeping;        // Workers sleeping on wait_cond
+
+  // Tasks for the main thread. Any thread pushes to main_incoming (newest
+  // first), and the main thread moves them to its own FIFO when draining.
+  _Atomic(eg_task_t *) main_incoming;
+  eg_task_t *main_head;
+  eg_task_t *main_tail;
+
+  // Jobs, protected by the mutex. Parked jobs are waiting for a group to
+  // finish, and parked_count is checked before taking the mutex.
+  struct eg_job_t *free_jobs;
+  struct eg_job_t *parked_jobs;
+  atomic_uint parked_count;
+
+  atomic_bool stop;
 } eg_task_scheduler_t;
 
-void eg_scheduler_init(eg_task_scheduler_t *scheduler, uint32_t num_workers);
+// Number of logical cores in the system
+uint32_t eg_cpu_core_count(void);
+
+eg_scheduler_options_t eg_default_scheduler_options(void);
 
+// Options can be NULL to use eg_default_scheduler_options(). Workers are
+// named "eg-worker-N", which shows up in debuggers and profilers.
+void eg_scheduler_init(
+    eg_task_scheduler_t *scheduler, const eg_scheduler_options_t *options);
+
+// Can be called from any thread, including from inside tasks. Tasks added
+// from a worker go to its own deque, where idle workers can steal them.
+// The task gets EG_TASK_PRIORITY_NORMAL.
 void eg_scheduler_add_task(
     eg_task_scheduler_t *scheduler, thrd_start_t routine, void *args);
 
+// Adds a task that decrements the group's count when it finishes
+void eg_scheduler_add_task_to_group(
+    eg_task_scheduler_t *scheduler,
+    eg_task_group_t *group,
+    thrd_start_t routine,
+    void *args);
+
+// Adds a task to the given lane. `group` can be NULL.
+void eg_scheduler_add_priority_task(
+    eg_task_scheduler_t *scheduler,
+    eg_task_priority_t priority,
+    eg_task_group_t *group,
+    thrd_start_t routine,
+    void *args);
+
+// Adds a task that runs on the main thread the next time it calls
+// eg_scheduler_run_main_tasks. Meant for work that can't run on workers, like
+// uploads that use the renderer's transient command pool. Can be called from
+// any thread, without locking.
+void eg_scheduler_add_main_task(
+    eg_task_scheduler_t *scheduler, thrd_start_t routine, void *args);
+
+// Runs main thread tasks in the order they were added, until there are none
+// left or `budget` seconds have passed (at least one task runs per call). The
+// rest wait for the next call. Must be called from the main thread.
+// Returns how many tasks ran.
+uint32_t
+eg_scheduler_run_main_tasks(eg_task_scheduler_t *scheduler, double budget);
+
+// Adds a job: a task that runs on its own stack, so it can stop halfway with
+// eg_job_yield or eg_job_wait and resume later, possibly on another thread.
+// This lets long loads be split across frames without turning them into state
+// machines. `group` can be NULL, and counts the job until its routine returns.
+//
+// Since a job can resume on another thread, it must not keep thread local
+// state (like eg_worker_id) across a yield.
+void eg_scheduler_add_job(
+    eg_task_scheduler_t *scheduler,
+    eg_task_priority_t priority,
+    eg_task_group_t *group,
+    thrd_start_t routine,
+    void *args);
+
+// The scheduler the calling thread is a worker of, or NULL on other threads
+// (including the main thread)
+eg_task_scheduler_t *eg_current_scheduler(void);
+
+// Whether the calling code runs inside a job
+bool eg_in_job(void);
+
+// Inside a job: lets the thread run other tasks, and puts the job back in the
+// scheduler to be resumed by any thread
+void eg_job_yield(void);
+
+// Inside a job: switches out until every task in the group has finished, so
+// the thread runs other tasks in the meantime
+void eg_job_wait(eg_task_group_t *group);
+
+// Runs the remaining tasks (main thread ones included) and stops the workers
 void eg_scheduler_destroy(eg_task_scheduler_t *scheduler);
+
+void eg_task_group_init(eg_task_group_t *group);
+
+// Sets the task added once every task in the group has finished, with the
+// priority of the task that finished last. It must be set before adding the
+// group's tasks, and it stays set until the group is initialized again. The
+// continuation counts as a task of `continuation_group` (if not NULL) from
+// this point on, so waiting on that group also waits for it.
+//
+// Tasks can finish while others are still being added, so the group holds an
+// extra count from here until eg_task_group_seal, and the continuation only
+// runs after that. Waiting on the group before sealing it never returns.
+void eg_task_group_set_continuation(
+    eg_task_group_t *group,
+    thrd_start_t routine,
+    void *args,
+    eg_task_group_t *continuation_group);
+
+// Marks the end of the tasks added to a group with a continuation. If they
+// have all finished already, the continuation is added right away with
+// EG_TASK_PRIORITY_NORMAL.
+void eg_task_group_seal(eg_task_scheduler_t *scheduler, eg_task_group_t *group);
+
+// Returns when every task in the group has finished. Instead of sleeping, the
+// calling thread runs pending high and normal priority tasks in the meantime.
+void eg_task_group_wait(eg_task_scheduler_t *scheduler, eg_task_group_t *group);
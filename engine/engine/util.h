@@ -1,6 +1,12 @@
 #pragma once
 
+#include <stdint.h>
 #include <stdio.h>
+#include <time.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #define _EG_LOG_INTERNAL(prefix, ...)                                          \
   do {                                                                         \
@@ -18,3 +24,32 @@
 #define EG_LOG_WARN(...) _EG_LOG_INTERNAL("[Engine-warn] ", __VA_ARGS__);
 #define EG_LOG_ERROR(...) _EG_LOG_INTERNAL("[Engine-error] ", __VA_ARGS__);
 #define EG_LOG_FATAL(...) _EG_LOG_INTERNAL("[Engine-fatal] ", __VA_ARGS__);
+
+// Index of the lowest set bit. `value` must not be 0.
+static inline uint32_t eg_ctz64(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return (uint32_t)index;
+#else
+  return (uint32_t)__builtin_ctzll(value);
+#endif
+}
+
+// Index of the highest set bit (floor of log2). `value` must not be 0.
+static inline uint32_t eg_log2_32(uint32_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse(&index, value);
+  return (uint32_t)index;
+#else
+  return 31 - (uint32_t)__builtin_clz(value);
+#endif
+}
+
+// Wall clock time in nanoseconds, for measuring short intervals
+static inline uint64_t eg_now_ns(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
@@ -0,0 +1,308 @@
+#include <engine/asset_manager.h>
+#include <engine/assets/image_asset.h>
+#include <engine/util.h>
+#include <renderer/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Looks assets up by UID through the manager's hash table and with a linear
+ * scan of the slots, then frees and adds assets over and over while checking
+ * that every lookup still finds the right asset. Last, times allocating and
+ * freeing assets at a steady rate, the way streaming does. The assets are
+ * images that are never initialized, so no device is needed.
+ *
+ * Then looks assets up from other threads while the main thread fills a new
+ * manager, growing its slots and UID table several times and freeing assets
+ * along the way, and checks that no lookup returns a freed or wrong asset.
+ */
+
+#define ASSET_COUNT 50000
+#define HASH_LOOKUPS 1000000
+#define LINEAR_LOOKUPS 1000
+#define DELETION_ROUNDS 20
+#define CHURN_FRAMES 1000
+#define CHURN_PER_FRAME 1000
+#define CONCURRENT_ASSETS 50000
+#define READER_COUNT 3
+
+static eg_asset_t *
+find_linear(eg_asset_manager_t *asset_manager, eg_asset_uid_t uid) {
+  uint32_t count = atomic_load(&asset_manager->count);
+  for (uint32_t i = 0; i < count; i++) {
+    eg_asset_t *asset = eg_asset_manager_get(asset_manager, i);
+    if (asset != NULL && asset->uid == uid) return asset;
+  }
+  return NULL;
+}
+
+static eg_asset_t *alloc_image(eg_asset_manager_t *asset_manager) {
+  return eg_asset_manager_alloc(asset_manager, EG_ASSET_TYPE(eg_image_asset_t));
+}
+
+// Runs enough frames for the freed assets to be destroyed
+static void drain_deletions(eg_asset_manager_t *asset_manager) {
+  for (uint32_t i = 0; i < RE_MAX_FRAMES_IN_FLIGHT; i++) {
+    eg_asset_manager_next_frame(asset_manager);
+  }
+}
+
+static void
+bench_lookups(eg_asset_manager_t *asset_manager, eg_asset_t **assets) {
+  uint32_t found = 0;
+
+  uint64_t start = eg_now_ns();
+  for (uint32_t i = 0; i < HASH_LOOKUPS; i++) {
+    eg_asset_t *asset = assets[rand() % ASSET_COUNT];
+    found += eg_asset_manager_get_by_uid(asset_manager, asset->uid) == asset;
+  }
+  double hash_ns = (double)(eg_now_ns() - start) / HASH_LOOKUPS;
+
+  start = eg_now_ns();
+  for (uint32_t i = 0; i < LINEAR_LOOKUPS; i++) {
+    eg_asset_t *asset = assets[rand() % ASSET_COUNT];
+    found += find_linear(asset_manager, asset->uid) == asset;
+  }
+  double linear_ns = (double)(eg_now_ns() - start) / LINEAR_LOOKUPS;
+
+  printf(
+      "%u assets: hash %8.1f ns per lookup, linear %10.1f ns per lookup "
+      "(%u found)\n",
+      ASSET_COUNT,
+      hash_ns,
+      linear_ns,
+      found);
+}
+
+// Frees a random half of the assets and adds new ones in their place, checking
+// that the freed UIDs can't be found and that the others still can. This
+// leaves plenty of tombstones in the UID table, and rebuilds it several times.
+static bool check_deletions(
+    eg_asset_manager_t *asset_manager, eg_asset_t **assets) {
+  eg_asset_uid_t *freed = malloc(ASSET_COUNT * sizeof(*freed));
+
+  for (uint32_t round = 0; round < DELETION_ROUNDS; round++) {
+    uint32_t freed_count = 0;
+    for (uint32_t i = 0; i < ASSET_COUNT; i++) {
+      if (rand() % 2) continue;
+      freed[freed_count++] = assets[i]->uid;
+      eg_asset_manager_free(asset_manager, assets[i]);
+      assets[i] = NULL;
+    }
+
+    for (uint32_t i = 0; i < freed_count; i++) {
+      if (eg_asset_manager_get_by_uid(asset_manager, freed[i]) != NULL) {
+        printf("Round %u: freed asset %u was found\n", round, freed[i]);
+        free(freed);
+        return false;
+      }
+    }
+
+    for (uint32_t i = 0; i < ASSET_COUNT; i++) {
+      if (assets[i] == NULL) continue;
+      if (eg_asset_manager_get_by_uid(asset_manager, assets[i]->uid) !=
+          assets[i]) {
+        printf("Round %u: asset %u wasn't found\n", round, assets[i]->uid);
+        free(freed);
+        return false;
+      }
+    }
+
+    for (uint32_t i = 0; i < ASSET_COUNT; i++) {
+      if (assets[i] == NULL) assets[i] = alloc_image(asset_manager);
+    }
+
+    drain_deletions(asset_manager);
+  }
+
+  free(freed);
+
+  printf(
+      "%u rounds of freeing half of %u assets: lookups ok\n",
+      DELETION_ROUNDS,
+      ASSET_COUNT);
+  return true;
+}
+
+// Every frame frees the oldest CHURN_PER_FRAME assets and allocates as many,
+// so the pools and the deletion queue reuse memory instead of growing
+static void
+bench_churn(eg_asset_manager_t *asset_manager, eg_asset_t **assets) {
+  uint32_t next = 0;
+
+  uint64_t start = eg_now_ns();
+  for (uint32_t frame = 0; frame < CHURN_FRAMES; frame++) {
+    for (uint32_t i = 0; i < CHURN_PER_FRAME; i++) {
+      eg_asset_manager_free(asset_manager, assets[next]);
+      assets[next] = alloc_image(asset_manager);
+      next         = (next + 1) % ASSET_COUNT;
+    }
+    eg_asset_manager_next_frame(asset_manager);
+  }
+  double ns = (double)(eg_now_ns() - start) / (CHURN_FRAMES * CHURN_PER_FRAME);
+
+  printf(
+      "%u frames of %u frees and allocations: %.1f ns per pair\n",
+      CHURN_FRAMES,
+      CHURN_PER_FRAME,
+      ns);
+}
+
+typedef struct concurrent_t {
+  eg_asset_manager_t asset_manager;
+  // Written by the main thread before the counts are increased
+  eg_asset_uid_t allocated[CONCURRENT_ASSETS];
+  eg_asset_uid_t freed[CONCURRENT_ASSETS];
+  atomic_uint allocated_count;
+  atomic_uint freed_count;
+  atomic_bool done;
+  atomic_uint lookups;
+  atomic_uint errors;
+} concurrent_t;
+
+static uint32_t xorshift(uint32_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+// Lookups can't lock, so this also checks that a lookup racing with a free
+// either misses or finds the right asset, and that once a free is seen the
+// asset isn't found anymore
+static int reader_thread(void *args) {
+  concurrent_t *concurrent          = args;
+  eg_asset_manager_t *asset_manager = &concurrent->asset_manager;
+  uint32_t state                    = (uint32_t)(uintptr_t)&state | 1;
+  uint32_t lookups                  = 0;
+
+  while (!atomic_load(&concurrent->done)) {
+    uint32_t freed_count = atomic_load(&concurrent->freed_count);
+    if (freed_count > 0) {
+      eg_asset_uid_t uid = concurrent->freed[xorshift(&state) % freed_count];
+      if (eg_asset_manager_get_by_uid(asset_manager, uid) != NULL) {
+        printf("Freed asset %u was found\n", uid);
+        atomic_fetch_add(&concurrent->errors, 1);
+      }
+      lookups++;
+    }
+
+    uint32_t allocated_count = atomic_load(&concurrent->allocated_count);
+    if (allocated_count > 0) {
+      eg_asset_uid_t uid =
+          concurrent->allocated[xorshift(&state) % allocated_count];
+      eg_asset_t *asset = eg_asset_manager_get_by_uid(asset_manager, uid);
+      if (eg_asset_try_retain(asset)) {
+        if (asset->uid != uid) {
+          printf("Looking up asset %u found asset %u\n", uid, asset->uid);
+          atomic_fetch_add(&concurrent->errors, 1);
+        }
+        eg_asset_release(asset);
+      }
+
+      // Whatever is in a slot must be the asset its UID leads to, unless it
+      // was just freed
+      eg_asset_t *slot = eg_asset_manager_get(
+          asset_manager, xorshift(&state) % allocated_count);
+      if (slot != NULL) {
+        eg_asset_t *found =
+            eg_asset_manager_get_by_uid(asset_manager, slot->uid);
+        if (found != NULL && found != slot) {
+          printf("Asset %u is in two places\n", slot->uid);
+          atomic_fetch_add(&concurrent->errors, 1);
+        }
+      }
+      lookups += 3;
+    }
+  }
+
+  atomic_fetch_add(&concurrent->lookups, lookups);
+  return 0;
+}
+
+// Every other allocation frees a random live asset. Assets aren't destroyed
+// until the next frame, so the readers can still dereference the ones they
+// find.
+static bool check_concurrent_lookups(void) {
+  concurrent_t *concurrent = malloc(sizeof(*concurrent));
+  eg_asset_manager_init(&concurrent->asset_manager);
+  atomic_init(&concurrent->allocated_count, 0);
+  atomic_init(&concurrent->freed_count, 0);
+  atomic_init(&concurrent->done, false);
+  atomic_init(&concurrent->lookups, 0);
+  atomic_init(&concurrent->errors, 0);
+
+  thrd_t readers[READER_COUNT];
+  for (uint32_t i = 0; i < READER_COUNT; i++) {
+    thrd_create(&readers[i], reader_thread, concurrent);
+  }
+
+  eg_asset_t **live   = malloc(CONCURRENT_ASSETS * sizeof(*live));
+  uint32_t live_count = 0;
+  uint32_t freed      = 0;
+
+  for (uint32_t i = 0; i < CONCURRENT_ASSETS; i++) {
+    eg_asset_t *asset        = alloc_image(&concurrent->asset_manager);
+    live[live_count++]       = asset;
+    concurrent->allocated[i] = asset->uid;
+    atomic_store(&concurrent->allocated_count, i + 1);
+
+    if (i % 2 == 1) {
+      uint32_t j               = rand() % live_count;
+      concurrent->freed[freed] = live[j]->uid;
+      eg_asset_manager_free(&concurrent->asset_manager, live[j]);
+      live[j] = live[--live_count];
+      atomic_store(&concurrent->freed_count, ++freed);
+    }
+  }
+
+  atomic_store(&concurrent->done, true);
+  for (uint32_t i = 0; i < READER_COUNT; i++) {
+    thrd_join(readers[i], NULL);
+  }
+
+  uint32_t errors = atomic_load(&concurrent->errors);
+  printf(
+      "%u threads, %u lookups while adding %u assets and freeing %u: "
+      "%u errors\n",
+      READER_COUNT,
+      atomic_load(&concurrent->lookups),
+      CONCURRENT_ASSETS,
+      freed,
+      errors);
+
+  for (uint32_t i = 0; i < live_count; i++) {
+    eg_asset_manager_free(&concurrent->asset_manager, live[i]);
+  }
+  drain_deletions(&concurrent->asset_manager);
+  free(live);
+  free(concurrent);
+
+  return errors == 0;
+}
+
+int main(void) {
+  eg_asset_manager_t asset_manager;
+  eg_asset_manager_init(&asset_manager);
+
+  eg_asset_t **assets = malloc(ASSET_COUNT * sizeof(*assets));
+  for (uint32_t i = 0; i < ASSET_COUNT; i++) {
+    assets[i] = alloc_image(&asset_manager);
+  }
+
+  bench_lookups(&asset_manager, assets);
+
+  bool ok = check_deletions(&asset_manager, assets);
+  if (ok) bench_churn(&asset_manager, assets);
+  if (ok) ok = check_concurrent_lookups();
+
+  // eg_asset_manager_destroy waits for the device, which isn't created here,
+  // so the assets are freed and destroyed through the deletion queue instead
+  for (uint32_t i = 0; i < ASSET_COUNT; i++) {
+    if (assets[i] != NULL) eg_asset_manager_free(&asset_manager, assets[i]);
+  }
+  drain_deletions(&asset_manager);
+  free(assets);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#include <engine/comps/transform_comp.h>
+#include <engine/entity_manager.h>
+#include <engine/util.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Adds, iterates and removes entities with a transform component, to see how
+ * the chunked storage behaves as the entity count grows
+ */
+
+static double ms_since(uint64_t start) {
+  return (double)(eg_now_ns() - start) / 1e6;
+}
+
+static void bench(uint32_t count) {
+  eg_entity_manager_t entity_manager;
+  eg_entity_manager_init(&entity_manager);
+
+  eg_entity_t *entities = malloc(count * sizeof(*entities));
+
+  uint64_t start = eg_now_ns();
+  for (uint32_t i = 0; i < count; i++) {
+    entities[i] = eg_entity_add(&entity_manager);
+    EG_ADD_COMP(&entity_manager, entities[i], eg_transform_comp_t);
+  }
+  double add_ms = ms_since(start);
+
+  start = eg_now_ns();
+  eg_query_iter_t iter = eg_query_iter(
+      &entity_manager,
+      &(eg_query_t){.all_comps = EG_COMP_BIT(eg_transform_comp_t)});
+  float sum = 0.0f;
+  eg_entity_t entity;
+  while (eg_query_next(&iter, &entity)) {
+    eg_transform_comp_t *transform =
+        EG_COMP(&entity_manager, entity, eg_transform_comp_t);
+    transform->position.x += 1.0f;
+    sum += transform->position.x;
+  }
+  double iterate_ms = ms_since(start);
+
+  // Remove every other entity and add them back, which goes through the free
+  // list instead of growing the storage
+  start = eg_now_ns();
+  for (uint32_t i = 0; i < count; i += 2) {
+    eg_entity_remove(&entity_manager, entities[i]);
+  }
+  for (uint32_t i = 0; i < count; i += 2) {
+    entities[i] = eg_entity_add(&entity_manager);
+    EG_ADD_COMP(&entity_manager, entities[i], eg_transform_comp_t);
+  }
+  double churn_ms = ms_since(start);
+
+  start = eg_now_ns();
+  for (uint32_t i = 0; i < count; i++) {
+    eg_entity_remove(&entity_manager, entities[i]);
+  }
+  double remove_ms = ms_since(start);
+
+  printf(
+      "%8u entities: add %8.2f ms, iterate %7.2f ms, churn %8.2f ms, "
+      "remove %8.2f ms (%g)\n",
+      count,
+      add_ms,
+      iterate_ms,
+      churn_ms,
+      remove_ms,
+      (double)sum);
+
+  free(entities);
+  eg_entity_manager_destroy(&entity_manager);
+}
+
+int main(void) {
+  static const uint32_t counts[] = {1000, 10000, 100000, 1000000};
+
+  for (uint32_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    bench(counts[i]);
+  }
+
+  return 0;
+}
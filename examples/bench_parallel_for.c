@@ -0,0 +1,110 @@
+#include <engine/comps/transform_comp.h>
+#include <engine/parallel_for.h>
+#include <engine/util.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Builds the matrices of 1M transforms with a serial loop, and then with
+ * eg_parallel_for_entities using from 2 threads up to one per core
+ */
+
+#define ENTITY_COUNT 1000000
+#define CHUNK_SIZE 4096
+#define ITERATIONS 10
+
+static void update_transforms(
+    eg_entity_manager_t *entity_manager,
+    const eg_entity_t *entities,
+    uint32_t count,
+    void *userdata) {
+  mat4_t *matrices = userdata;
+
+  for (uint32_t i = 0; i < count; i++) {
+    eg_transform_comp_t *transform =
+        EG_COMP(entity_manager, entities[i], eg_transform_comp_t);
+    transform->angle += 0.01f;
+    matrices[EG_ENTITY_INDEX(entities[i])] = eg_transform_comp_mat4(transform);
+  }
+}
+
+// Best time out of ITERATIONS runs. A NULL scheduler runs the serial loop.
+static double run(
+    eg_task_scheduler_t *scheduler,
+    eg_entity_manager_t *entity_manager,
+    mat4_t *matrices) {
+  const eg_query_t query = {.all_comps = EG_COMP_BIT(eg_transform_comp_t)};
+
+  uint64_t best = UINT64_MAX;
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    uint64_t start = eg_now_ns();
+
+    if (scheduler == NULL) {
+      eg_query_iter_t iter = eg_query_iter(entity_manager, &query);
+      eg_entity_t entity;
+      while (eg_query_next(&iter, &entity)) {
+        update_transforms(entity_manager, &entity, 1, matrices);
+      }
+    } else {
+      eg_parallel_for_entities(
+          scheduler,
+          entity_manager,
+          &query,
+          CHUNK_SIZE,
+          update_transforms,
+          matrices);
+    }
+
+    uint64_t time = eg_now_ns() - start;
+    if (time < best) best = time;
+  }
+  return (double)best / 1e6;
+}
+
+int main(void) {
+  eg_entity_manager_t entity_manager;
+  eg_entity_manager_init(&entity_manager);
+
+  for (uint32_t i = 0; i < ENTITY_COUNT; i++) {
+    eg_entity_t entity = eg_entity_add(&entity_manager);
+    eg_transform_comp_t *transform =
+        EG_ADD_COMP(&entity_manager, entity, eg_transform_comp_t);
+    transform->position = (vec3_t){(float)i, 0.0f, 0.0f};
+    transform->angle    = (float)i;
+  }
+
+  mat4_t *matrices = malloc(entity_manager.entity_max * sizeof(*matrices));
+
+  double serial_ms = run(NULL, &entity_manager, matrices);
+  printf(
+      "%u transforms, serial loop: %8.2f ms\n", ENTITY_COUNT, serial_ms);
+
+  uint32_t core_count = eg_cpu_core_count();
+  for (uint32_t threads = 2; threads <= core_count; threads *= 2) {
+    eg_scheduler_options_t options = eg_default_scheduler_options();
+    options.num_workers            = threads - 1;
+
+    eg_task_scheduler_t scheduler;
+    eg_scheduler_init(&scheduler, &options);
+
+    double ms = run(&scheduler, &entity_manager, matrices);
+    printf(
+        "%u transforms, %2u threads: %8.2f ms (%.2fx)\n",
+        ENTITY_COUNT,
+        threads,
+        ms,
+        serial_ms / ms);
+
+    eg_scheduler_destroy(&scheduler);
+
+    // Also measure with every core when it's not a power of two
+    if (threads < core_count && threads * 2 > core_count) {
+      threads = core_count / 2;
+    }
+  }
+
+  free(matrices);
+  eg_entity_manager_destroy(&entity_manager);
+
+  return 0;
+}
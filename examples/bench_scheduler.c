@@ -0,0 +1,249 @@
+#include <engine/task_scheduler.h>
+#include <engine/util.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Runs a million tasks that do next to nothing, so the time is spent in the
+ * scheduler itself. They're added once from the main thread, which goes
+ * through the shared queue, and once from inside tasks, which puts them in a
+ * worker's deque for the other workers to steal.
+ *
+ * Then runs bursts of short tasks separated by idle gaps, like a frame that
+ * only uses the workers for part of its time, under each idle policy. For
+ * each one it reports how long tasks wait before a worker starts them, and
+ * how much CPU time the process burns compared to the wall time.
+ *
+ * Before all that, checks that a group's continuation runs exactly once when
+ * workers finish the group's first tasks while the rest are still being added.
+ */
+
+#define TASK_COUNT 1000000
+#define SPAWNER_COUNT 1000
+
+#define CONTINUATION_ROUNDS 10000
+#define CONTINUATION_TASKS 4
+
+#define FRAME_COUNT 200
+#define BURST_SIZE 64
+#define BURST_TASK_NS 20000
+#define IDLE_GAP_NS 2000000
+
+typedef struct bench_t {
+  eg_task_scheduler_t *scheduler;
+  eg_task_group_t group;
+  // Per thread stats, on separate cache lines
+  struct {
+    uint32_t count;
+    uint32_t latency_count;
+    uint64_t latency_ns; // Sum of the waits of the burst tasks run by workers
+    char pad[64 - 2 * sizeof(uint32_t) - sizeof(uint64_t)];
+  } ran[EG_MAX_THREADS];
+  uint64_t burst_start;
+  atomic_uint continuations;
+} bench_t;
+
+static bench_t bench;
+
+static int tiny_task(void *args) {
+  bench.ran[eg_worker_id].count++;
+  return 0;
+}
+
+static int spawner_task(void *args) {
+  for (uint32_t i = 0; i < TASK_COUNT / SPAWNER_COUNT; i++) {
+    eg_scheduler_add_task_to_group(
+        bench.scheduler, &bench.group, tiny_task, NULL);
+  }
+  return 0;
+}
+
+static int burst_task(void *args) {
+  uint64_t start = eg_now_ns();
+  // Only the workers' waits, the main thread runs tasks while it waits for the
+  // group anyway
+  if (eg_worker_id != 0) {
+    bench.ran[eg_worker_id].latency_ns += start - bench.burst_start;
+    bench.ran[eg_worker_id].latency_count++;
+  }
+  while (eg_now_ns() - start < BURST_TASK_NS) {
+  }
+  return 0;
+}
+
+static int continuation_task(void *args) {
+  atomic_fetch_add(&bench.continuations, 1);
+  return 0;
+}
+
+static bool check_continuations(eg_task_scheduler_t *scheduler) {
+  atomic_init(&bench.continuations, 0);
+
+  for (uint32_t round = 0; round < CONTINUATION_ROUNDS; round++) {
+    eg_task_group_t done;
+    eg_task_group_init(&done);
+    eg_task_group_init(&bench.group);
+    eg_task_group_set_continuation(
+        &bench.group, continuation_task, NULL, &done);
+
+    // Give the workers time to finish each task before adding the next one,
+    // yielding in case they share a core with this thread
+    for (uint32_t i = 0; i < CONTINUATION_TASKS; i++) {
+      eg_scheduler_add_task_to_group(scheduler, &bench.group, tiny_task, NULL);
+      uint64_t start = eg_now_ns();
+      while (eg_now_ns() - start < 2000) {
+      }
+      thrd_yield();
+    }
+    eg_task_group_seal(scheduler, &bench.group);
+
+    // Not eg_task_group_wait on `done`, which never returns if the
+    // continuation runs more than once and its count goes below zero
+    eg_task_group_wait(scheduler, &bench.group);
+    while (atomic_load(&done.count) == 1) {
+      thrd_yield();
+    }
+
+    if (atomic_load(&done.count) != 0 ||
+        atomic_load(&bench.continuations) != round + 1) {
+      printf(
+          "Round %u: the continuation ran %u times in total\n",
+          round,
+          atomic_load(&bench.continuations));
+      return false;
+    }
+  }
+
+  for (uint32_t i = 0; i < EG_MAX_THREADS; i++) {
+    bench.ran[i].count = 0;
+  }
+
+  printf("%u continuations ran once each\n", CONTINUATION_ROUNDS);
+  return true;
+}
+
+// Prints the throughput, and how many threads the tasks were spread over
+static void report(const char *name, uint64_t start) {
+  double ms = (double)(eg_now_ns() - start) / 1e6;
+
+  uint32_t threads = 0;
+  uint32_t busiest = 0;
+  for (uint32_t i = 0; i < EG_MAX_THREADS; i++) {
+    if (bench.ran[i].count > 0) threads++;
+    if (bench.ran[i].count > busiest) busiest = bench.ran[i].count;
+    bench.ran[i].count = 0;
+  }
+
+  printf(
+      "%-12s %8.2f ms, %6.1f ns per task, %2u threads (busiest ran %.1f%%)\n",
+      name,
+      ms,
+      ms * 1e6 / TASK_COUNT,
+      threads,
+      100.0 * busiest / TASK_COUNT);
+}
+
+static void
+run_bursts(const char *name, const eg_scheduler_options_t *options) {
+  eg_task_scheduler_t scheduler;
+  eg_scheduler_init(&scheduler, options);
+
+  uint64_t start      = eg_now_ns();
+  clock_t cpu_start   = clock();
+  struct timespec gap = {.tv_nsec = IDLE_GAP_NS};
+
+  for (uint32_t frame = 0; frame < FRAME_COUNT; frame++) {
+    eg_task_group_init(&bench.group);
+    bench.burst_start = eg_now_ns();
+    for (uint32_t i = 0; i < BURST_SIZE; i++) {
+      eg_scheduler_add_task_to_group(
+          &scheduler, &bench.group, burst_task, NULL);
+    }
+    eg_task_group_wait(&scheduler, &bench.group);
+
+    thrd_sleep(&gap, NULL);
+  }
+
+  double wall_ms = (double)(eg_now_ns() - start) / 1e6;
+  double cpu_ms  = (double)(clock() - cpu_start) * 1e3 / CLOCKS_PER_SEC;
+
+  eg_scheduler_destroy(&scheduler);
+
+  uint64_t latency_ns    = 0;
+  uint32_t latency_count = 0;
+  for (uint32_t i = 0; i < EG_MAX_THREADS; i++) {
+    latency_ns += bench.ran[i].latency_ns;
+    latency_count += bench.ran[i].latency_count;
+    bench.ran[i].latency_ns    = 0;
+    bench.ran[i].latency_count = 0;
+  }
+
+  printf(
+      "%-12s latency %8.2f us, wall %8.2f ms, cpu %8.2f ms (%.2f cores)\n",
+      name,
+      latency_count > 0 ? (double)latency_ns / latency_count / 1e3 : 0.0,
+      wall_ms,
+      cpu_ms,
+      cpu_ms / wall_ms);
+}
+
+int main(void) {
+  eg_task_scheduler_t scheduler;
+  eg_scheduler_init(&scheduler, NULL);
+  bench.scheduler = &scheduler;
+
+  if (!check_continuations(&scheduler)) {
+    return 1;
+  }
+
+  printf("%u workers, %u tasks\n", scheduler.num_workers, TASK_COUNT);
+
+  eg_task_group_init(&bench.group);
+  uint64_t start = eg_now_ns();
+  for (uint32_t i = 0; i < TASK_COUNT; i++) {
+    eg_scheduler_add_task_to_group(&scheduler, &bench.group, tiny_task, NULL);
+  }
+  eg_task_group_wait(&scheduler, &bench.group);
+  report("main thread", start);
+
+  eg_task_group_init(&bench.group);
+  start = eg_now_ns();
+  for (uint32_t i = 0; i < SPAWNER_COUNT; i++) {
+    eg_scheduler_add_task_to_group(
+        &scheduler, &bench.group, spawner_task, NULL);
+  }
+  eg_task_group_wait(&scheduler, &bench.group);
+  report("from tasks", start);
+
+  eg_scheduler_destroy(&scheduler);
+
+  printf(
+      "\n%u frames of %u tasks of %u us, %u ms apart\n",
+      FRAME_COUNT,
+      BURST_SIZE,
+      BURST_TASK_NS / 1000,
+      IDLE_GAP_NS / 1000000);
+
+  eg_scheduler_options_t options = eg_default_scheduler_options();
+  run_bursts("default", &options);
+
+  options.pin_workers = true;
+  run_bursts("pinned", &options);
+
+  // Sleep as soon as there's nothing to do
+  options             = eg_default_scheduler_options();
+  options.spin_count  = 0;
+  options.yield_count = 0;
+  run_bursts("park", &options);
+
+  // Long enough that the workers never get to sleep during the gaps
+  options.spin_count  = 0;
+  options.yield_count = 100000000;
+  run_bursts("yield", &options);
+
+  options.spin_count  = 100000000;
+  options.yield_count = 0;
+  run_bursts("spin", &options);
+
+  return 0;
+}
@@ -0,0 +1,179 @@
+#include <engine/comps/hierarchy_comp.h>
+#include <engine/comps/transform_comp.h>
+#include <engine/systems/transform_system.h>
+#include <engine/util.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Builds the world matrices of the same transforms with the scalar kernel and
+ * with eg_transform_batch (AVX when the engine is built with it), checks that
+ * they match and compares their timings. Also checks that the transform system
+ * gives detached entities their own matrix back.
+ */
+
+#define TRANSFORM_COUNT 100000
+#define ITERATIONS 20
+#define EPSILON 1e-4f
+
+static float random_float(float min, float max) {
+  return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+static void fill_soa(eg_transform_soa_t *soa, uint32_t count) {
+  float **arrays = (float **)soa;
+  for (uint32_t i = 0; i < sizeof(*soa) / sizeof(float *); i++) {
+    arrays[i] = malloc(count * sizeof(float));
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t j = 0; j < 3; j++) {
+      soa->position[j][i] = random_float(-100.0f, 100.0f);
+      soa->axis[j][i]     = random_float(-1.0f, 1.0f);
+      soa->scale[j][i]    = random_float(0.1f, 10.0f);
+    }
+    soa->angle[i] = random_float(-10.0f, 10.0f);
+  }
+
+  // A zero axis is left alone instead of normalized
+  soa->axis[0][0] = soa->axis[1][0] = soa->axis[2][0] = 0.0f;
+}
+
+// Returns the largest difference between the two sets of matrices, relative to
+// the magnitude of the elements
+static float max_difference(const mat4_t *a, const mat4_t *b, uint32_t count) {
+  float max_diff = 0.0f;
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t j = 0; j < 16; j++) {
+      float x    = a[i].elems[j];
+      float y    = b[i].elems[j];
+      float diff = fabsf(x - y) / fmaxf(1.0f, fmaxf(fabsf(x), fabsf(y)));
+      if (diff > max_diff) max_diff = diff;
+    }
+  }
+  return max_diff;
+}
+
+// Attaches a child to a translated parent and detaches it again, both by
+// clearing its parent and by removing its hierarchy component. Its transform
+// isn't touched, so only the hierarchy can change its world matrix.
+static bool check_detach(void) {
+  eg_entity_manager_t entity_manager;
+  eg_entity_manager_init(&entity_manager);
+
+  eg_transform_system_t system;
+  eg_transform_system_init(&system);
+
+  eg_entity_t parent = eg_entity_add(&entity_manager);
+  eg_transform_comp_t *parent_transform =
+      EG_ADD_COMP(&entity_manager, parent, eg_transform_comp_t);
+  parent_transform->position = (vec3_t){10.0f, 0.0f, 0.0f};
+
+  eg_entity_t child = eg_entity_add(&entity_manager);
+  EG_ADD_COMP(&entity_manager, child, eg_transform_comp_t);
+
+  bool ok = true;
+
+  for (uint32_t remove = 0; remove < 2; remove++) {
+    eg_hierarchy_comp_t *hierarchy =
+        EG_ADD_COMP(&entity_manager, child, eg_hierarchy_comp_t);
+    eg_hierarchy_comp_set_parent(hierarchy, parent);
+
+    eg_transform_system_update(&system, &entity_manager);
+    mat4_t attached = eg_transform_system_world(&system, child);
+
+    if (remove) {
+      EG_REMOVE_COMP(&entity_manager, child, eg_hierarchy_comp_t);
+    } else {
+      eg_hierarchy_comp_set_parent(hierarchy, EG_NULL_ENTITY);
+    }
+
+    eg_transform_system_update(&system, &entity_manager);
+    mat4_t detached = eg_transform_system_world(&system, child);
+
+    if (attached.cols[3][0] != 10.0f || detached.cols[3][0] != 0.0f) {
+      printf(
+          "Detaching by %s: world translation %g when attached, %g when "
+          "detached\n",
+          remove ? "removing the hierarchy" : "clearing the parent",
+          (double)attached.cols[3][0],
+          (double)detached.cols[3][0]);
+      ok = false;
+    }
+  }
+
+  eg_transform_system_destroy(&system);
+  eg_entity_manager_destroy(&entity_manager);
+
+  return ok;
+}
+
+typedef void (*kernel_t)(
+    const eg_transform_soa_t *soa,
+    const uint32_t *indices,
+    uint32_t count,
+    mat4_t *world);
+
+// Best time out of ITERATIONS runs
+static double time_kernel(
+    kernel_t kernel,
+    const eg_transform_soa_t *soa,
+    const uint32_t *indices,
+    mat4_t *world) {
+  uint64_t best = UINT64_MAX;
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    uint64_t start = eg_now_ns();
+    kernel(soa, indices, TRANSFORM_COUNT, world);
+    uint64_t time = eg_now_ns() - start;
+    if (time < best) best = time;
+  }
+  return (double)best / 1e6;
+}
+
+int main(void) {
+  if (!check_detach()) {
+    return 1;
+  }
+
+  eg_transform_soa_t soa;
+  fill_soa(&soa, TRANSFORM_COUNT);
+
+  uint32_t *indices = malloc(TRANSFORM_COUNT * sizeof(*indices));
+  for (uint32_t i = 0; i < TRANSFORM_COUNT; i++) {
+    indices[i] = i;
+  }
+
+  mat4_t *scalar = malloc(TRANSFORM_COUNT * sizeof(*scalar));
+  mat4_t *batch  = malloc(TRANSFORM_COUNT * sizeof(*batch));
+
+  double scalar_ms =
+      time_kernel(eg_transform_batch_scalar, &soa, indices, scalar);
+  double batch_ms = time_kernel(eg_transform_batch, &soa, indices, batch);
+
+  float diff = max_difference(scalar, batch, TRANSFORM_COUNT);
+
+  printf(
+      "%u transforms: scalar %.3f ms, batch %.3f ms (%.2fx), "
+      "max difference %g\n",
+      TRANSFORM_COUNT,
+      scalar_ms,
+      batch_ms,
+      scalar_ms / batch_ms,
+      (double)diff);
+
+  if (diff > EPSILON) {
+    printf("The batch kernel doesn't match the scalar one\n");
+    return 1;
+  }
+
+  free(scalar);
+  free(batch);
+  free(indices);
+  float **arrays = (float **)&soa;
+  for (uint32_t i = 0; i < sizeof(soa) / sizeof(float *); i++) {
+    free(arrays[i]);
+  }
+
+  return 0;
+}
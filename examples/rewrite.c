@@ -6,16 +6,77 @@
 #pragma comment(linker, "/SUBSYSTEM:windows /ENTRY:mainCRTStartup")
 #endif
 
+// Seconds per frame spent on tasks that have to run on the main thread
+#define MAIN_TASK_BUDGET 0.002
+
 typedef struct game_t {
   re_window_t window;
 
   eg_asset_manager_t asset_manager;
   eg_scene_t scene;
 
+  eg_task_scheduler_t scheduler;
+  eg_system_registry_t systems;
+
   eg_fps_camera_system_t fps_system;
   eg_inspector_t inspector;
 } game_t;
 
+static void fps_camera_system(void *userdata) {
+  game_t *game = userdata;
+  eg_fps_camera_system_update(
+      &game->fps_system,
+      &game->window,
+      re_window_get_cmd_buffer(&game->window));
+}
+
+static void transform_system(void *userdata) {
+  game_t *game = userdata;
+  eg_transform_system_update(
+      &game->scene.transform_system, &game->scene.entity_manager);
+}
+
+static void light_system(void *userdata) {
+  game_t *game = userdata;
+  eg_light_system(&game->scene);
+}
+
+static void register_systems(game_t *game) {
+  // Reads window input and updates the camera's uniform buffer
+  eg_system_registry_add(
+      &game->systems,
+      &(eg_system_desc_t){
+          .name        = "FPS camera",
+          .run         = fps_camera_system,
+          .userdata    = game,
+          .writes      = EG_ACCESS_RESOURCE(EG_SYSTEM_RESOURCE_CAMERA),
+          .main_thread = true,
+      });
+
+  eg_system_registry_add(
+      &game->systems,
+      &(eg_system_desc_t){
+          .name     = "Transform",
+          .run      = transform_system,
+          .userdata = game,
+          .writes   = EG_ACCESS_COMP(eg_transform_comp_t) |
+                      EG_ACCESS_COMP(eg_hierarchy_comp_t) |
+                      EG_ACCESS_RESOURCE(EG_SYSTEM_RESOURCE_WORLD_MATRICES),
+      });
+
+  eg_system_registry_add(
+      &game->systems,
+      &(eg_system_desc_t){
+          .name     = "Light",
+          .run      = light_system,
+          .userdata = game,
+          .reads    = EG_ACCESS_COMP(eg_transform_comp_t) |
+                      EG_ACCESS_COMP(eg_point_light_comp_t) |
+                      EG_ACCESS_RESOURCE(EG_SYSTEM_RESOURCE_WORLD_MATRICES),
+          .writes   = EG_ACCESS_RESOURCE(EG_SYSTEM_RESOURCE_ENVIRONMENT),
+      });
+}
+
 static eg_entity_t add_gltf(
     game_t *game,
     const char *path,
@@ -23,11 +84,14 @@ static eg_entity_t add_gltf(
     vec3_t position,
     vec3_t scale,
     bool flip_uvs) {
-  eg_gltf_asset_t *model_asset = eg_asset_manager_alloc(
-      &game->asset_manager, EG_ASSET_TYPE(eg_gltf_asset_t));
-  eg_gltf_asset_init(
-      model_asset,
-      &(eg_gltf_asset_options_t){.path = path, .flip_uvs = flip_uvs});
+  // Drawn once it has finished loading
+  eg_gltf_asset_t *model_asset = eg_asset_manager_load_async(
+      &game->asset_manager,
+      &game->scheduler,
+      EG_ASSET_TYPE(eg_gltf_asset_t),
+      &(eg_gltf_asset_options_t){.path = path, .flip_uvs = flip_uvs},
+      NULL,
+      NULL);
   eg_asset_set_name(&model_asset->asset, path);
 
   eg_entity_t ent = eg_entity_add(&game->scene.entity_manager);
@@ -167,34 +231,46 @@ int main(int argc, const char *argv[]) {
 
   eg_asset_manager_init(&game.asset_manager);
 
-  eg_image_asset_t *skybox = eg_asset_manager_alloc(
-      &game.asset_manager, EG_ASSET_TYPE(eg_image_asset_t));
-  eg_image_asset_init(
-      skybox,
+  eg_scheduler_init(&game.scheduler, NULL);
+
+  // The environment is loaded in the background, and renders black until then
+  eg_image_asset_t *skybox = eg_asset_manager_load_async(
+      &game.asset_manager,
+      &game.scheduler,
+      EG_ASSET_TYPE(eg_image_asset_t),
       &(eg_image_asset_options_t){
-          .path = "/assets/environments/bridge_skybox.ktx"});
+          .path = "/assets/environments/bridge_skybox.ktx"},
+      NULL,
+      NULL);
   eg_asset_set_name(&skybox->asset, "Skybox");
 
-  eg_image_asset_t *irradiance = eg_asset_manager_alloc(
-      &game.asset_manager, EG_ASSET_TYPE(eg_image_asset_t));
-  eg_image_asset_init(
-      irradiance,
+  eg_image_asset_t *irradiance = eg_asset_manager_load_async(
+      &game.asset_manager,
+      &game.scheduler,
+      EG_ASSET_TYPE(eg_image_asset_t),
       &(eg_image_asset_options_t){
-          .path = "/assets/environments/bridge_irradiance.ktx"});
+          .path = "/assets/environments/bridge_irradiance.ktx"},
+      NULL,
+      NULL);
   eg_asset_set_name(&irradiance->asset, "Irradiance");
 
-  eg_image_asset_t *radiance = eg_asset_manager_alloc(
-      &game.asset_manager, EG_ASSET_TYPE(eg_image_asset_t));
-  eg_image_asset_init(
-      radiance,
+  eg_image_asset_t *radiance = eg_asset_manager_load_async(
+      &game.asset_manager,
+      &game.scheduler,
+      EG_ASSET_TYPE(eg_image_asset_t),
       &(eg_image_asset_options_t){
-          .path = "/assets/environments/bridge_radiance.ktx"});
+          .path = "/assets/environments/bridge_radiance.ktx"},
+      NULL,
+      NULL);
   eg_asset_set_name(&radiance->asset, "Radiance");
 
-  eg_image_asset_t *brdf = eg_asset_manager_alloc(
-      &game.asset_manager, EG_ASSET_TYPE(eg_image_asset_t));
-  eg_image_asset_init(
-      brdf, &(eg_image_asset_options_t){.path = "/assets/brdf_lut.png"});
+  eg_image_asset_t *brdf = eg_asset_manager_load_async(
+      &game.asset_manager,
+      &game.scheduler,
+      EG_ASSET_TYPE(eg_image_asset_t),
+      &(eg_image_asset_options_t){.path = "/assets/brdf_lut.png"},
+      NULL,
+      NULL);
   eg_asset_set_name(&brdf->asset, "BRDF LuT");
 
   eg_scene_init(&game.scene, skybox, irradiance, radiance, brdf);
@@ -208,6 +284,9 @@ int main(int argc, const char *argv[]) {
       &game.asset_manager);
   eg_fps_camera_system_init(&game.fps_system, &game.scene.camera);
 
+  eg_system_registry_init(&game.systems);
+  register_systems(&game);
+
   eg_pipeline_asset_t *pbr_pipeline = eg_asset_manager_alloc(
       &game.asset_manager, EG_ASSET_TYPE(eg_pipeline_asset_t));
   eg_pipeline_asset_init(
@@ -293,6 +372,9 @@ int main(int argc, const char *argv[]) {
       }
     }
 
+    // GPU uploads queued by worker tasks, before this frame starts recording
+    eg_scheduler_run_main_tasks(&game.scheduler, MAIN_TASK_BUDGET);
+
     re_cmd_buffer_t *cmd_buffer = re_window_get_cmd_buffer(&game.window);
 
     eg_imgui_begin();
@@ -305,9 +387,14 @@ int main(int argc, const char *argv[]) {
     re_ctx_begin_frame();
     re_window_begin_frame(&game.window);
 
-    eg_fps_camera_system_update(&game.fps_system, &game.window, cmd_buffer);
+    // Destroy the assets released by frames that have finished on the GPU
+    eg_asset_manager_next_frame(&game.asset_manager);
+
+    // Apply the structural changes recorded by the inspector, and by the
+    // systems during the previous frame
+    eg_ecs_cmd_buffer_flush(&game.scene.cmd_buffer, &game.scene.entity_manager);
 
-    eg_light_system(&game.scene);
+    eg_system_registry_run(&game.systems, &game.scheduler);
 
     // Begin window renderpass
     re_window_begin_render_pass(&game.window);
@@ -344,6 +431,11 @@ int main(int argc, const char *argv[]) {
 
   eg_inspector_destroy(&game.inspector);
 
+  eg_asset_manager_wait_for_loads(&game.asset_manager, &game.scheduler);
+
+  eg_system_registry_destroy(&game.systems);
+  eg_scheduler_destroy(&game.scheduler);
+
   eg_scene_destroy(&game.scene);
   eg_asset_manager_destroy(&game.asset_manager);
 
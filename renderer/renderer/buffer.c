@@ -289,8 +289,6 @@ void re_image_transfer_to_buffer(
 }
 
 void re_buffer_destroy(re_buffer_t *buffer) {
-  VK_CHECK(vkDeviceWaitIdle(g_ctx.device));
-
   if (buffer->buffer != VK_NULL_HANDLE &&
       buffer->allocation != VK_NULL_HANDLE) {
     vmaDestroyBuffer(g_ctx.gpu_allocator, buffer->buffer, buffer->allocation);
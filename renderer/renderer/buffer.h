@@ -65,4 +65,6 @@ void re_image_transfer_to_buffer(
     uint32_t layer,
     uint32_t level);
 
+// Doesn't wait for the device, the caller must make sure the GPU is done with
+// the buffer. The transfer functions wait for their copies to finish.
 void re_buffer_destroy(re_buffer_t *buffer);
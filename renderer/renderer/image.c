@@ -201,8 +201,6 @@ void re_image_upload(
 }
 
 void re_image_destroy(re_image_t *image) {
-  VK_CHECK(vkDeviceWaitIdle(g_ctx.device));
-
   if (image->image != VK_NULL_HANDLE) {
     vkDestroyImageView(g_ctx.device, image->image_view, NULL);
     vkDestroySampler(g_ctx.device, image->sampler, NULL);
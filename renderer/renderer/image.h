@@ -62,4 +62,6 @@ void re_image_upload(
     uint32_t level,
     uint32_t layer);
 
+// Doesn't wait for the device, the caller must make sure the GPU is done with
+// the image
 void re_image_destroy(re_image_t *image);
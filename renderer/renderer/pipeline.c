@@ -288,8 +288,6 @@ void re_pipeline_layout_init(
 }
 
 void re_pipeline_layout_destroy(re_pipeline_layout_t *layout) {
-  VK_CHECK(vkDeviceWaitIdle(g_ctx.device));
-
   if (layout->layout != VK_NULL_HANDLE) {
     vkDestroyPipelineLayout(g_ctx.device, layout->layout, NULL);
   }
@@ -376,8 +374,6 @@ VkPipeline re_pipeline_get(
 }
 
 void re_pipeline_destroy(re_pipeline_t *pipeline) {
-  VK_CHECK(vkDeviceWaitIdle(g_ctx.device));
-
   re_pipeline_layout_destroy(&pipeline->layout);
 
   for (uint32_t i = 0; i < pipeline->pipeline_count; i++) {
@@ -99,4 +99,6 @@ void re_pipeline_init_graphics(
 VkPipeline re_pipeline_get(
     re_pipeline_t *pipeline, const re_render_target_t *render_target);
 
+// Doesn't wait for the device, the caller must make sure the GPU is done with
+// the pipeline
 void re_pipeline_destroy(re_pipeline_t *pipeline);
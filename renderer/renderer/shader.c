@@ -22,8 +22,6 @@ void re_shader_init_spv(
 }
 
 void re_shader_destroy(re_shader_t *shader) {
-  VK_CHECK(vkDeviceWaitIdle(g_ctx.device));
-
   if (shader->module != VK_NULL_HANDLE) {
     vkDestroyShaderModule(g_ctx.device, shader->module, NULL);
     shader->module = VK_NULL_HANDLE;